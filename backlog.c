@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+#include "emulator.h"
+#include "backlog.h"
+
+/* ******************************************************************
+   Sender backlogs.
+
+   A message that finds the window full waits in the sender's backlog,
+   and is sent once ACKs make room for it, instead of being dropped.
+   Only when the backlog is full too is a message dropped (counted in
+   window_full).  The backlog counts in the flow's statistics how many
+   messages waited, how long for, and how many waited at a time, so
+   that a saturated sender shows up as a growing queue rather than as
+   lost messages.  Both protocols hand their messages from layer 5 to
+   the backlog, which sends them through the protocol's struct sender
+   when there is room.
+
+   Each entry is the time the message was added followed by the message.
+**********************************************************************/
+
+/* the time a message was added and the message in entry i of b */
+#define QUEUED(b, i) ((double *)((b)->entries + (i)*(b)->entrysize))
+#define MESSAGE(b, i) ((struct msg *)((b)->entries + (i)*(b)->entrysize + sizeof(double)))
+
+size_t backlogstorage(int capacity, int msgsize)
+{
+  size_t entrysize = sizeof(double) + offsetof(struct msg, data) + msgsize;
+
+  entrysize = (entrysize + sizeof(double)-1) & ~(sizeof(double)-1);
+  return capacity * entrysize;
+}
+
+void backloginit(struct backlog *b, void *storage, int capacity, int msgsize)
+{
+  b->entries = storage;
+  b->entrysize = capacity > 0 ? backlogstorage(capacity, msgsize) / capacity : 0;
+  b->head = 0;
+  b->count = 0;
+  b->capacity = capacity;
+  b->lastchange = 0.0;
+}
+
+/* count the messages waiting since the last change, before count changes */
+static void backlogchange(struct backlog *b)
+{
+  protocolstats()->backlog_area += b->count * (simtime() - b->lastchange);
+  b->lastchange = simtime();
+}
+
+bool backlogadd(struct backlog *b, const struct msg *message)
+{
+  struct sim_stats *stats = protocolstats();
+  int i;
+
+  if (b->count == b->capacity)
+    return false;
+  backlogchange(b);
+  i = (b->head + b->count) % b->capacity;
+  *QUEUED(b, i) = simtime();
+  memcpy(MESSAGE(b, i), message, offsetof(struct msg, data) + message->length);
+  b->count++;
+  stats->backlogged++;
+  if (b->count > stats->backlog_peak)
+    stats->backlog_peak = b->count;
+  return true;
+}
+
+const struct msg *backlognext(const struct backlog *b)
+{
+  return b->count > 0 ? MESSAGE(b, b->head) : NULL;
+}
+
+void backlogremove(struct backlog *b)
+{
+  backlogchange(b);
+  protocolstats()->backlog_wait += simtime() - *QUEUED(b, b->head);
+  b->head = (b->head + 1) % b->capacity;
+  b->count--;
+}
+
+void backlogoutput(struct backlog *b, const struct sender *s, int entity,
+                   const struct msg *message)
+{
+  /* if not blocked waiting on ACK; the whole message must fit in the
+     window, behind any messages already waiting for it */
+  if (b->count == 0 && s->room(entity, message->length)) {
+    if (TRACING(1))
+      printf("----%c: New message arrives, send window is not full, send new messge to layer3!\n", 'A'+entity);
+    s->send(entity, message);
+  }
+  /* if blocked, the message waits for the window unless the backlog is full too */
+  else if (backlogadd(b, message)) {
+    if (TRACING(0))
+      printf("----%c: New message arrives, send window is full, message waits in backlog\n", 'A'+entity);
+  }
+  else {
+    if (TRACING(0))
+      printf("----%c: New message arrives, send window is full\n", 'A'+entity);
+    protocolstats()->window_full++;
+  }
+}
+
+void backlogdrain(struct backlog *b, const struct sender *s, int entity)
+{
+  const struct msg *message;
+
+  while ((message = backlognext(b)) != NULL && s->room(entity, message->length)) {
+    if (TRACING(0))
+      printf("----%c: send window has room, send message waiting in backlog to layer3!\n", 'A'+entity);
+    s->send(entity, message);
+    backlogremove(b);
+  }
+}
@@ -0,0 +1,45 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+/* messages a sender holds until its window has room, see backlog.c */
+
+/* the messages waiting, oldest first, in a ring of capacity entries in
+   storage the protocol provides */
+struct backlog {
+  char *entries;          /* capacity entries of entrysize bytes */
+  size_t entrysize;
+  int head, count, capacity;
+  double lastchange;      /* time count last changed */
+};
+
+/* bytes of storage for capacity messages of msgsize bytes, a multiple of
+   the alignment of a double */
+extern size_t backlogstorage(int capacity, int msgsize);
+
+/* set up b to hold capacity messages of msgsize bytes in storage */
+extern void backloginit(struct backlog *b, void *storage, int capacity, int msgsize);
+
+/* copy message to the back of b.  False if b is full */
+extern bool backlogadd(struct backlog *b, const struct msg *message);
+
+/* the oldest message in b, or NULL if b is empty */
+extern const struct msg *backlognext(const struct backlog *b);
+
+/* drop the oldest message of b, once it has been sent */
+extern void backlogremove(struct backlog *b);
+
+/* the sender of an entity, as its backlog sees it */
+struct sender {
+  bool (*room)(int entity, int length);     /* a message of length bytes can be sent now */
+  void (*send)(int entity, const struct msg *message);  /* send one there is room for */
+};
+
+/* a message from layer 5 for entity's sender, whose backlog is b: sent at
+   once if nothing is waiting and there is room, else added to b, else
+   dropped */
+extern void backlogoutput(struct backlog *b, const struct sender *s, int entity,
+                          const struct msg *message);
+
+/* send the messages waiting in b that there is room for, oldest first,
+   now that ACKs have made some */
+extern void backlogdrain(struct backlog *b, const struct sender *s, int entity);
@@ -0,0 +1,320 @@
+/* ******************************************************************
+   Benchmarks of the emulator and a protocol.
+
+   Measures the cost of the emulator's basic operations with a given
+   number of events pending, and the wall time and event rate of whole
+   simulations in a few fixed scenarios.  Every measurement is printed as
+   one line of JSON, so the output of two commits can be compared with
+   any JSON tool:
+
+     bench [-tag name] [-r repeats] [-quick] [-protocol name]
+
+   -tag names the build in every line (heap, notrace, ...), -r sets how
+   many times each measurement is repeated (the best one is reported),
+   -quick runs smaller scenarios and -protocol runs the scenarios with
+   only the protocol named (gbn, sr) rather than with each in turn, under
+   the same seed.
+
+   The emulator is included whole so that its internal routines can be
+   timed directly:
+
+   build: make bench, or make bench-notrace without tracing (-DTRACEMAX=0).
+   make run-bench builds and runs it, into bench-<commit>.json
+**********************************************************************/
+#define EMULATOR_NO_MAIN
+#include "emulator.c"
+#include <time.h>
+
+#define OPBATCH 64          /* operations timed together */
+#define NOPS 200000         /* operations per measurement */
+
+struct scenario {
+  const char *name;
+  int msgs;
+  float loss, corrupt;
+  float lambda;
+  int payloadsize, msgsize;
+  int bidirectional;
+  int nflows, bottleneck;
+  int adaptiverto;
+  int windowsize;         /* 0 for the protocol's own */
+  int backlog;
+  int congestion;
+  double bandwidth;       /* 0 for the unlimited medium */
+  int queuelimit, aqm;
+};
+
+static const struct scenario scenarios[] = {
+  { "noloss",          20000, 0.0, 0.0, 20.0,    20,   20,   0, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "loss10",          20000, 0.1, 0.0, 20.0,    20,   20,   0, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "loss30corrupt30", 20000, 0.3, 0.3, 20.0,    20,   20,   0, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "light",           20000, 0.0, 0.0, 1000.0,  20,   20,   0, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "mtu1500",         20000, 0.1, 0.0, 20.0,    1500, 1500, 0, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "jumbo9000",       20000, 0.1, 0.0, 20.0,    9000, 9000, 0, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "segmented9000",   20000, 0.1, 0.0, 120.0,   1500, 9000, 0, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "bidir",           20000, 0.1, 0.0, 100.0,   20,   20,   1, 1,    0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "flows100",        200,   0.1, 0.0, 20.0,    20,   20,   0, 100,  0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "flows1000",       20,    0.1, 0.0, 20.0,    20,   20,   0, 1000, 0, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "bottleneck100",   200,   0.1, 0.0, 10000.0, 20,   20,   0, 100,  1, 0, 0,    0,    0, 0.0,  0,  0 },
+  { "loss10rto",       20000, 0.1, 0.0, 20.0,    20,   20,   0, 1,    0, 1, 0,    0,    0, 0.0,  0,  0 },
+  { "bidirrto",        20000, 0.1, 0.0, 100.0,   20,   20,   1, 1,    0, 1, 0,    0,    0, 0.0,  0,  0 },
+  { "window1024",      20000, 0.1, 0.0, 6.0,     20,   20,   0, 1,    0, 1, 1024, 0,    0, 0.0,  0,  0 },
+  { "backlog1000",     20000, 0.1, 0.0, 20.0,    20,   20,   0, 1,    0, 1, 0,    1000, 0, 0.0,  0,  0 },
+  { "bottleneckaimd",  300,   0.0, 0.0, 100.0,   20,   20,   0, 20,   1, 1, 32,   0,    1, 0.0,  0,  0 },
+  { "bottleneckcubic", 300,   0.0, 0.0, 100.0,   20,   20,   0, 20,   1, 1, 32,   0,    2, 0.0,  0,  0 },
+  { "droptail",        5000,  0.0, 0.0, 2.0,     20,   20,   0, 4,    1, 1, 32,   50,   1, 36.0, 20, 0 },
+  { "red",             5000,  0.0, 0.0, 2.0,     20,   20,   0, 4,    1, 1, 32,   50,   1, 36.0, 20, 1 },
+  { "codel",           5000,  0.0, 0.0, 2.0,     20,   20,   0, 4,    1, 1, 32,   50,   1, 36.0, 20, 2 },
+};
+#define NSCENARIOS (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+static const int depths[] = { 10, 100, 1000, 10000, 100000 };
+#define NDEPTHS (int)(sizeof(depths) / sizeof(depths[0]))
+
+static const char *tag = "";
+static int repeats = 3;
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void defaultparams(struct sim_params *params)
+{
+  memset(params, 0, sizeof(struct sim_params));
+  params->nsimmax = 1;
+  params->corruptdirection = 2;
+  params->lambda = 10.0;
+  params->trace = 0;
+  params->seed = 9999;
+  params->payloadsize = 20;
+  params->msgsize = 20;
+  params->nflows = 1;
+  params->linkdelay = LINKDELAY;
+}
+
+/* a simulation with depth events pending, all due after time 1000, made
+   current as if it were being run */
+static struct sim_context *filledsim(int depth)
+{
+  struct sim_params params;
+  struct sim_context *sim;
+  struct event *p;
+  int i;
+
+  defaultparams(&params);
+  sim = sim_create(&params);
+  if (sim == NULL)
+    exit(EXIT_FAILURE);
+  for (i=0; i<depth; i++) {
+    p = newevent(sim);
+    p->evtime = 1000.0 + 1e6*jimsrand(sim, RNG_ARRIVAL);
+    p->evtype = FROM_LAYER5;
+    p->eventity = A;
+    insertevent(sim, p);
+  }
+  cursim = sim;
+  return sim;
+}
+
+static void emptysim(struct sim_context *sim)
+{
+  cursim = NULL;
+  sim_destroy(sim);
+}
+
+/* nanoseconds per insertevent of an event at a random time */
+static double benchinsert(struct sim_context *sim)
+{
+  struct event *batch[OPBATCH];
+  double t, total = 0.0;
+  int i, n;
+
+  for (n=0; n<NOPS; n+=OPBATCH) {
+    for (i=0; i<OPBATCH; i++) {
+      batch[i] = newevent(sim);
+      batch[i]->evtime = 1000.0 + 1e6*jimsrand(sim, RNG_ARRIVAL);
+      batch[i]->evtype = FROM_LAYER5;
+      batch[i]->eventity = A;
+    }
+    t = now();
+    for (i=0; i<OPBATCH; i++)
+      insertevent(sim, batch[i]);
+    total += now() - t;
+    for (i=0; i<OPBATCH; i++) {
+      removeevent(sim, batch[i]);
+      freeevent(sim, batch[i]);
+    }
+  }
+  return total * 1e9 / n;
+}
+
+/* nanoseconds per starttimer and stoptimer pair */
+static double benchtimer(struct sim_context *sim)
+{
+  double t;
+  int n;
+
+  t = now();
+  for (n=0; n<NOPS; n++) {
+    starttimer(A, 16.0);
+    stoptimer(A);
+  }
+  return (now() - t) * 1e9 / n;
+}
+
+/* nanoseconds per startidtimer and stopidtimer pair, on 64 timers */
+static double benchidtimer(struct sim_context *sim)
+{
+  double t;
+  int n, i;
+
+  t = now();
+  for (n=0; n<NOPS; n+=OPBATCH) {
+    for (i=0; i<OPBATCH; i++)
+      startidtimer(A, i, 16.0 + i);
+    for (i=0; i<OPBATCH; i++)
+      stopidtimer(A, i);
+  }
+  return (now() - t) * 1e9 / n;
+}
+
+/* nanoseconds per tolayer3 of a full packet that is neither lost nor
+   corrupted */
+static double benchtolayer3(struct sim_context *sim)
+{
+  struct pkt *packet;
+  double t, total = 0.0;
+  int i, n;
+
+  packet = calloc(1, pktsize());
+  if (packet == 0) {
+    printf("memory allocation for packet failed.");
+    exit(EXIT_FAILURE);
+  }
+  packet->length = payloadsize();
+  for (n=0; n<NOPS; n+=OPBATCH) {
+    t = now();
+    for (i=0; i<OPBATCH; i++)
+      tolayer3(A, packet);
+    total += now() - t;
+    /* the new packets arrive before anything else pending */
+    for (i=0; i<OPBATCH; i++)
+      freeevent(sim, popevent(sim));
+    sim->flows[0].channels[B].inflight = 0;
+  }
+  free(packet);
+  return total * 1e9 / n;
+}
+
+static void benchop(const char *op, double (*bench)(struct sim_context *))
+{
+  struct sim_context *sim;
+  double ns, best;
+  int d, r;
+
+  for (d=0; d<NDEPTHS; d++) {
+    best = 0.0;
+    for (r=0; r<repeats; r++) {
+      sim = filledsim(depths[d]);
+      ns = bench(sim);
+      emptysim(sim);
+      if (r == 0 || ns < best)
+        best = ns;
+    }
+    printf("{\"tag\":\"%s\",\"bench\":\"op\",\"op\":\"%s\",\"depth\":%d,\"ns\":%.2f}\n",
+           tag, op, depths[d], best);
+    fflush(stdout);
+  }
+}
+
+static void benchscenario(const struct scenario *sc, int protocol, int quick)
+{
+  struct sim_params params;
+  struct sim_context *sim;
+  struct sim_stats stats;
+  double t, secs, best = 0.0;
+  int r;
+
+  memset(&stats, 0, sizeof(stats));
+  defaultparams(&params);
+  params.nsimmax = quick ? (sc->msgs + 9) / 10 : sc->msgs;
+  params.lossprob = sc->loss;
+  params.corruptprob = sc->corrupt;
+  params.lambda = sc->lambda;
+  params.payloadsize = sc->payloadsize;
+  params.msgsize = sc->msgsize;
+  params.bidirectional = sc->bidirectional;
+  params.nflows = sc->nflows;
+  params.bottleneck = sc->bottleneck;
+  params.adaptiverto = sc->adaptiverto;
+  params.windowsize = sc->windowsize;
+  params.backlog = sc->backlog;
+  params.congestion = sc->congestion;
+  params.protocol = protocol;
+  params.bandwidth = sc->bandwidth;
+  params.queuelimit = sc->queuelimit;
+  params.aqm = sc->aqm;
+  for (r=0; r<repeats; r++) {
+    sim = sim_create(&params);
+    if (sim == NULL)
+      exit(EXIT_FAILURE);
+    t = now();
+    if (sim_run(sim) < 0)
+      exit(EXIT_FAILURE);
+    secs = now() - t;
+    stats = *sim_getstats(sim);
+    sim_destroy(sim);
+    if (r == 0 || secs < best)
+      best = secs;
+  }
+  printf("{\"tag\":\"%s\",\"bench\":\"scenario\",\"scenario\":\"%s\",\"protocol\":\"%s\",\"msgs\":%d,"
+         "\"events\":%ld,\"seconds\":%.6f,\"events_per_second\":%.0f,"
+         "\"delivered\":%d,\"bytes_per_time\":%f,\"latency_p99\":%f,\"fairness\":%f,"
+         "\"resent\":%d,\"spurious\":%d,\"dropped\":%d,\"backlog_delay\":%f,"
+         "\"queue_drops\":%d,\"queue_delay\":%f}\n",
+         tag, sc->name, protocols[protocol]->name, params.nsimmax * params.nflows, stats.nevents, best,
+         best > 0.0 ? stats.nevents / best : 0.0, stats.messages_delivered,
+         stats.goodput_bytes, stats.latency_p99, stats.fairness,
+         stats.packets_resent, stats.spurious_resends, stats.window_full,
+         stats.backlog_delay, stats.queue_drops, stats.queue_delay);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+  int quick = 0, protocol = -1;
+  int i, p;
+
+  for (i=1; i<argc; i++) {
+    if (strcmp(argv[i], "-tag") == 0 && i+1 < argc)
+      tag = argv[++i];
+    else if (strcmp(argv[i], "-r") == 0 && i+1 < argc)
+      repeats = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-quick") == 0)
+      quick = 1;
+    else if (strcmp(argv[i], "-protocol") == 0 && i+1 < argc &&
+             (protocol = findprotocol(argv[++i])) >= 0)
+      ;
+    else {
+      fprintf(stderr, "usage: bench [-tag name] [-r repeats] [-quick] [-protocol name]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  if (repeats < 1)
+    repeats = 1;
+  TRACE = 0;
+
+  benchop("insertevent", benchinsert);
+  benchop("starttimer+stoptimer", benchtimer);
+  benchop("startidtimer+stopidtimer", benchidtimer);
+  benchop("tolayer3", benchtolayer3);
+  for (i=0; i<NSCENARIOS; i++)
+    for (p=0; p<NPROTOCOLS; p++)
+      if (protocol < 0 || p == protocol)
+        benchscenario(&scenarios[i], p, quick);
+  return EXIT_SUCCESS;
+}
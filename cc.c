@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <math.h>
+#include "emulator.h"
+#include "cc.h"
+
+/* ******************************************************************
+   Congestion control.
+
+   A sender may have at most min(cwnd, window) packets unACKed.  How
+   cwnd changes is up to the algorithm, through its hooks:
+
+   - AIMD (as TCP Reno): cwnd starts at one packet and grows by one per
+   ACKed packet (doubling every round trip) up to ssthresh, then by one
+   per round trip.  Three duplicate ACKs halve it; a timeout sets
+   ssthresh to half the packets in flight and starts again from one.
+   - Cubic (after RFC 8312): after a loss cwnd is cut to 0.7 of what it
+   was, wmax, and then grows as C(t-K)^3 + wmax, with t the time since
+   the loss in round trips, so it comes back to wmax quickly, stays there
+   a while and only then probes further.  It never grows more slowly
+   than AIMD would.
+
+   cwnd is reduced once per loss episode.  A reduction marks the packets
+   sent so far, and the loss or timeout of any of them afterwards (the
+   rest of the window lost with it, or the same packet timing out again)
+   is taken as part of the same congestion, as TCP's recovery point does
+   (RFC 6582), rather than cutting cwnd again and again.
+
+   cwnd only grows while the sender is using it, so a sender that is
+   limited by its window or has nothing to send doesn't build up a
+   window it has never tried.  Nor does Cubic count the time a sender
+   sat idle as time spent growing.  Every change is reported to the
+   emulator (see reportcwnd()), which traces it.
+**********************************************************************/
+
+#define INITCWND 1.0      /* cwnd at the start, and after a timeout */
+#define MINSSTHRESH 2.0
+#define NOLIMIT 1e9       /* ssthresh before the first loss, and cwnd without congestion control */
+#define DUPTHRESH 3       /* duplicate ACKs taken as a loss */
+#define CUBICC 0.4        /* Cubic's scaling constant, in packets per RTT^3 */
+#define CUBICBETA 0.7     /* and what it keeps of cwnd on a loss */
+
+static void report(const struct cc *c)
+{
+  reportcwnd(c->entity, c->cwnd, c->ssthresh < NOLIMIT ? c->ssthresh : -1.0);
+}
+
+/********* AIMD ************/
+
+static void aimdinit(struct cc *c)
+{
+  c->cwnd = INITCWND;
+}
+
+static void aimdacked(struct cc *c, int packets, double rtt)
+{
+  if (c->cwnd < c->ssthresh)
+    c->cwnd += packets;
+  else
+    c->cwnd += packets / c->cwnd;
+}
+
+static void aimdloss(struct cc *c)
+{
+  c->ssthresh = c->cwnd / 2 > MINSSTHRESH ? c->cwnd / 2 : MINSSTHRESH;
+  c->cwnd = c->ssthresh;
+}
+
+static void aimdtimeout(struct cc *c, int inflight)
+{
+  c->ssthresh = inflight / 2.0 > MINSSTHRESH ? inflight / 2.0 : MINSSTHRESH;
+  c->cwnd = INITCWND;
+}
+
+/********* Cubic ************/
+
+/* start growing again from cwnd, towards the wmax it was cut from */
+static void cubicreduce(struct cc *c)
+{
+  c->wmax = c->cwnd;
+  c->cwnd = c->cwnd * CUBICBETA > MINSSTHRESH ? c->cwnd * CUBICBETA : MINSSTHRESH;
+  c->ssthresh = c->cwnd;
+  c->epoch = -1.0;
+}
+
+/* a packet sent into an empty window ends an idle period, which is
+   taken out of the time cwnd has been growing (as Linux does) */
+static void cubicsent(struct cc *c, int inflight)
+{
+  if (inflight == 1 && c->epoch >= 0.0 && c->lastacked > c->epoch)
+    c->epoch += simtime() - c->lastacked;
+}
+
+static void cubicacked(struct cc *c, int packets, double rtt)
+{
+  double t, target;
+
+  if (c->cwnd < c->ssthresh) {
+    c->cwnd += packets;
+    return;
+  }
+  if (c->epoch < 0.0) {
+    c->epoch = simtime();
+    if (c->wmax < c->cwnd)
+      c->wmax = c->cwnd;
+    c->k = cbrt((c->wmax - c->cwnd) / CUBICC);
+    c->west = c->cwnd;
+  }
+  t = (simtime() - c->epoch) / (rtt > 0.0 ? rtt : 1.0);
+  target = CUBICC * (t - c->k) * (t - c->k) * (t - c->k) + c->wmax;
+
+  /* AIMD with the same average decrease would have grown west */
+  c->west += 3 * (1 - CUBICBETA) / (1 + CUBICBETA) * packets / c->cwnd;
+  if (target < c->west)
+    target = c->west;
+  if (target > c->cwnd)
+    c->cwnd += (target - c->cwnd) / c->cwnd * packets;
+}
+
+static void cubicloss(struct cc *c)
+{
+  cubicreduce(c);
+}
+
+static void cubictimeout(struct cc *c, int inflight)
+{
+  cubicreduce(c);
+  c->cwnd = INITCWND;
+}
+
+/********* The algorithms by CC_ code ************/
+
+static const struct ccalgo algos[NCC] = {
+  { "none",  NULL,      NULL,       NULL,       NULL,      NULL },
+  { "aimd",  aimdinit,  NULL,       aimdacked,  aimdloss,  aimdtimeout },
+  { "cubic", aimdinit,  cubicsent,  cubicacked, cubicloss, cubictimeout },
+};
+
+void ccinit(struct cc *c, int algorithm, int entity)
+{
+  c->algo = &algos[algorithm];
+  c->entity = entity;
+  c->cwnd = NOLIMIT;
+  c->ssthresh = NOLIMIT;
+  c->dupacks = 0;
+  c->limited = false;
+  c->lastacked = 0.0;
+  c->sent = 0;
+  c->acked = 0;
+  c->recover = 0;
+  c->wmax = 0.0;
+  c->epoch = -1.0;
+  c->k = 0.0;
+  c->west = 0.0;
+  if (c->algo->init) {
+    c->algo->init(c);
+    report(c);
+  }
+}
+
+int ccwindow(const struct cc *c, int window)
+{
+  return c->cwnd < window ? (int)c->cwnd : window;
+}
+
+/* a message goes whatever the congestion window once nothing is in flight,
+   or one bigger than it would never go */
+bool ccroom(const struct cc *c, int window, int inflight, int npackets)
+{
+  return inflight + npackets <= ccwindow(c, window) ||
+         (inflight == 0 && npackets <= window);
+}
+
+/* true if the packet offset after the oldest unACKed one was sent before
+   the last reduction */
+static bool sameepisode(const struct cc *c, int offset)
+{
+  return c->acked + offset < c->recover;
+}
+
+void ccsent(struct cc *c, int inflight)
+{
+  c->sent++;
+  if (inflight >= (int)c->cwnd)
+    c->limited = true;
+  if (c->algo->sent)
+    c->algo->sent(c, inflight);
+}
+
+void ccacked(struct cc *c, int packets, double rtt)
+{
+  c->dupacks = 0;
+  c->acked += packets;
+  c->lastacked = simtime();
+  if (c->limited && c->algo->acked) {
+    c->algo->acked(c, packets, rtt);
+    report(c);
+  }
+  c->limited = false;
+}
+
+/* duplicate ACKs are for the packet after the oldest unACKed one not
+   having arrived, so it is the oldest that was lost */
+void ccdupack(struct cc *c)
+{
+  if (++c->dupacks == DUPTHRESH && c->algo->loss && !sameepisode(c, 0)) {
+    c->algo->loss(c);
+    c->recover = c->sent;
+    report(c);
+  }
+}
+
+void cctimeout(struct cc *c, int inflight, int offset)
+{
+  c->dupacks = 0;
+  if (c->algo->timeout && !sameepisode(c, offset)) {
+    c->algo->timeout(c, inflight);
+    c->recover = c->sent;
+    report(c);
+  }
+}
@@ -0,0 +1,72 @@
+#include <stdbool.h>
+
+/* congestion control of the senders, see cc.c */
+
+/* algorithms, as chosen by congestioncontrol() */
+#define CC_NONE   0       /* only the window limits the sender */
+#define CC_AIMD   1       /* slow start, then additive increase, multiplicative decrease */
+#define CC_CUBIC  2       /* window a cubic function of the time since the last loss */
+#define NCC       3
+
+struct cc;
+
+/* the hooks of an algorithm, called by the functions below.  Any of
+   them can be NULL */
+struct ccalgo {
+  const char *name;
+  void (*init)(struct cc *c);
+  void (*sent)(struct cc *c, int inflight);              /* a new packet was sent */
+  void (*acked)(struct cc *c, int packets, double rtt);  /* ACKs moved the window on */
+  void (*loss)(struct cc *c);                            /* duplicate ACKs showed a loss */
+  void (*timeout)(struct cc *c, int inflight);           /* a packet timed out */
+};
+
+/* the congestion state of one sender */
+struct cc {
+  const struct ccalgo *algo;
+  int entity;             /* A or B, for reporting the window */
+  double cwnd;            /* congestion window, in packets */
+  double ssthresh;        /* slow start while cwnd is below this */
+  int dupacks;            /* duplicate ACKs since the window last moved */
+  bool limited;           /* cwnd was reached since the last ACK */
+  double lastacked;       /* time ACKs last moved the window on */
+
+  /* packets are numbered from 0 in the order they are first sent, and
+     the window moves on over them in that order */
+  int sent;               /* new packets sent */
+  int acked;              /* packets the window has moved on over */
+  int recover;            /* packets sent before the last reduction of cwnd.
+                             Their losses are part of the episode that
+                             caused it, and don't reduce it again */
+
+  /* Cubic */
+  double wmax;            /* cwnd before the last reduction */
+  double epoch;           /* time the current growth started, or < 0 */
+  double k;               /* time from epoch until cwnd is back at wmax, in RTTs */
+  double west;            /* cwnd AIMD would have, as a lower bound */
+};
+
+/* set up c for entity with algorithm, a CC_ code (sim_create() turns
+   down any other) */
+extern void ccinit(struct cc *c, int algorithm, int entity);
+
+/* packets a sender with a window of window packets may have in flight */
+extern int ccwindow(const struct cc *c, int window);
+
+/* true if a sender with inflight packets unACKed may send npackets more
+   with a window of window packets */
+extern bool ccroom(const struct cc *c, int window, int inflight, int npackets);
+
+/* the sender has sent a new packet and now has inflight packets unACKed */
+extern void ccsent(struct cc *c, int inflight);
+
+/* ACKs have moved the window on by packets; rtt is the smoothed round
+   trip time, 0 if not known yet */
+extern void ccacked(struct cc *c, int packets, double rtt);
+
+/* an ACK arrived that didn't move the window on */
+extern void ccdupack(struct cc *c);
+
+/* a packet timed out with inflight packets unACKed, offset packets after
+   the oldest of them */
+extern void cctimeout(struct cc *c, int inflight, int offset);
@@ -0,0 +1,14 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* packet checksums for the protocols, see checksum.c */
+
+/* CRC32C of len bytes at data, continuing from crc (0 to start) */
+extern uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+/* the checksum of packet, covering everything but its checksum field */
+extern int ComputeChecksum(const struct pkt *packet);
+
+/* true if packet's checksum doesn't match its contents */
+extern bool IsCorrupted(const struct pkt *packet);
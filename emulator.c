@@ -23,7 +23,8 @@
    - packets can be corrupted (either the header or the data portion)
    or lost, according to user-defined probabilities
    - packets will be delivered in the order in which they were sent
-   (although some can be lost).
+   (although some can be lost), unless the medium is asked to hold
+   packets back or duplicate them
 
    Modifications (6/6/2008 - CLP): 
    - removed bidirectional GBN code and other code not used by prac. 
@@ -36,85 +37,433 @@
    ********************************************************************* */
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
 #include "emulator.h"
-#include "gbn.h"
+#include "protocol.h"
+#include "sweep.h"
+#include "trace.h"
+#include "metrics.h"
+#include "link.h"
+#include "cc.h"
+
+/* event queue engines.  The heap is the default; the original sorted
+   list is kept as a reference engine so that runs can be compared against
+   it (compile with -DEVQUEUE=EVQUEUE_LIST).  Both engines simulate events
+   in exactly the same order. */
+#define  EVQUEUE_LIST    0
+#define  EVQUEUE_HEAP    1
+#ifndef EVQUEUE
+#define EVQUEUE EVQUEUE_HEAP
+#endif
+#define HEAPARITY 4            /* children per heap node */
 
 struct event {
-  float evtime;           /* event time */
+  double evtime;          /* event time */
   int evtype;             /* event type code */
   int eventity;           /* entity where event occurs */
-  struct pkt *pktptr;     /* ptr to packet (if any) assoc w/ this event */
-  struct event *prev;
+  int evflow;             /* flow the entity belongs to */
+  struct pkt *pkt;        /* packet (if any) assoc w/ this event */
+  int evtimerid;          /* logical timer id (IDTIMER_INTERRUPT only) */
+  unsigned long evseq;    /* insertion order, breaks ties on evtime */
+  int heapidx;            /* position in evheap (heap engine only) */
+  struct event *prev;     /* neighbours in evlist (list engine only) */
   struct event *next;
 };
 
-struct event *evlist = NULL;   /* the event list */
+
+/* events are carved out of slabs and recycled through a free list rather
+   than malloc'd and freed one at a time; the slabs are released together
+   when the simulation terminates */
+#define EVSLABSIZE 1024        /* events per slab */
+struct evslab {
+  struct evslab *next;
+  struct event events[EVSLABSIZE];
+};
+
+/* packets in the network are kept in buffers big enough for a full
+   payload, carved out of slabs and recycled like the events.  A free
+   buffer holds the link to the next one. */
+#define PKTSLABSIZE 256        /* packet buffers per slab */
+struct pktslab {
+  struct pktslab *next;        /* followed by PKTSLABSIZE buffers */
+};
+struct freepkt {
+  struct freepkt *next;
+};
 
 /* possible events: */
 #define  TIMER_INTERRUPT 0  
 #define  FROM_LAYER5     1
 #define  FROM_LAYER3     2
+#define  IDTIMER_INTERRUPT 3
+#define  WHEEL_TICK      4
 
 #define  OFF             0
 #define  ON              1
 
-int TRACE = 3;
-
-/* statistics updated by GBN */
-int window_full;   /* count of the number of messages dropped due to full window */
-int total_ACKs_received;
-int packets_resent;       /* count of the number of packets resent  */
-int new_ACKs;           /* count of the number of acks correctly received */
-int packets_received;  /* count of the packets received by receiver */
-
-/* statistics updated by emulator */
-static int packets_lost;  
-static int packets_corrupt;
-static int packets_sent;
-static int packets_timeout;
-static int messages_delivered;
-
-static int nsim = 0;              /* number of messages from 5 to 4 so far */ 
-static int nsimmax = 0;           /* number of msgs to generate, then stop */
-static float time = 0.000;
-static float lossprob;            /* probability that a packet is dropped  */
-static float corruptprob;   /* probability that one bit is packet is flipped */
-static int corruptdirection; /* A->B A<-B or bidirectional corruption/loss */
-static float lambda;        /* arrival rate of messages from layer 5 */   
-static int   ntolayer3;           /* number sent into layer 3 */
-static int   nlost;               /* number lost in media */
-static int ncorrupt;              /* number corrupted by media*/
+/* logical timers (see startidtimer()) wait in a hashed timer wheel, so
+   arming and cancelling them is O(1) however many are running.  The wheel
+   has one slot per WHEELTICK time units; a single WHEEL_TICK event is kept
+   queued for the earliest occupied slot, and when it fires the timers due
+   in that slot are moved onto the event queue to go off at their exact
+   expiry time. */
+#define  WHEELSLOTS      256    /* slots in the wheel, a power of two */
+#define  WHEELTICK       4.0    /* time units covered by one slot */
+#define  IDCHUNK         32     /* logical timers allocated together */
+
+#define  IDTIMER_OFF     0      /* not running */
+#define  IDTIMER_WHEEL   1      /* waiting in the wheel */
+#define  IDTIMER_QUEUED  2      /* due soon, event is on the event queue */
+
+struct idtimer {
+  int flow;               /* flow of the entity */
+  int entity;             /* A or B */
+  int timerid;            /* id given by the entity */
+  int state;              /* IDTIMER_OFF, IDTIMER_WHEEL or IDTIMER_QUEUED */
+  double expiry;          /* time the timer goes off */
+  long tick;              /* wheel tick the expiry falls in */
+  struct event *ev;       /* its IDTIMER_INTERRUPT event when queued */
+  struct idtimer *prev;   /* neighbours in the wheel slot */
+  struct idtimer *next;
+};
+
+/* the medium towards each entity (indexed by the receiving entity) */
+struct channel {
+  double lastarrival; /* latest arrival time of the packets in flight */
+  int inflight;       /* number of packets in flight */
+  struct link link;   /* the link and its queue, if bandwidth is limited */
+  int bad;            /* 1 if in the bad (bursty loss) state */
+};
+
+/* a flow: a pair of entities A and B, with its own protocol state,
+   timers and statistics.  The flows of a simulation only meet in the
+   event queue and, if they share a bottleneck, in the medium. */
+struct flow {
+  struct event *timers[2];    /* pending TIMER_INTERRUPT at A and B */
+  struct idtimer **idtimers[2];  /* timer id -> chunk of IDCHUNK timers */
+  int nidchunks[2];           /* number of chunks for A and B */
+  struct channel channels[2]; /* the flow's own medium */
+  void *protocolstate;        /* see protocolstate() */
+  struct sim_stats stats;     /* see protocolstats() */
+  struct flowmetrics metrics;
+};
+
+/* random number streams.  Each source of randomness draws from its own
+   stream, so that changing (say) the loss probability does not change
+   the message arrival times or link delays. */
+#define  RNG_ARRIVAL     0      /* message arrivals from layer 5 */
+#define  RNG_LOSS        1      /* packet loss */
+#define  RNG_CORRUPT     2      /* packet corruption */
+#define  RNG_DELAY       3      /* link delay */
+#define  RNG_QUEUE       4      /* early drops by a router queue */
+#define  RNG_BURST       5      /* changes of the Gilbert-Elliott loss state */
+#define  RNG_REORDER     6      /* packets held back, and for how long */
+#define  RNG_DUPLICATE   7      /* packets duplicated */
+#define  NRNGSTREAMS     8
+#define  RNGBLOCK        64     /* uniforms generated at a time */
+
+struct rngstream {
+  uint64_t s[4];              /* xoshiro256+ state */
+  double block[RNGBLOCK];     /* uniforms not yet handed out */
+  int next;                   /* next one to hand out from block */
+};
+
+/* a binary trace being written.  Records are collected here and written
+   out a buffer at a time; the buffer belongs to the thread running the
+   simulation, so no locking is needed. */
+#define  TRACEBUF        4096   /* records written at a time */
+
+struct tracebuf {
+  FILE *f;
+  int count;                  /* records in rec */
+  struct tracerec rec[TRACEBUF];
+};
+
+/* everything belonging to one simulation.  Nothing in the emulator is
+   kept in globals, so any number of simulations can exist at once and
+   each thread can run one (see sim_run()). */
+struct sim_context {
+  struct sim_params params;
+  struct sim_stats stats;
+  double time;                /* current simulation time */
+  struct rngstream rng[NRNGSTREAMS];  /* see jimsrand() */
+
+  /* the event queue */
+#if EVQUEUE == EVQUEUE_LIST
+  struct event *evlist;       /* the event list */
+#else
+  struct event **evheap;      /* the event heap, earliest at [0] */
+  int evcount;                /* number of events in the heap */
+  int evcapacity;             /* allocated size of evheap */
+#endif
+  unsigned long evseqnext;    /* evseq given to the next event */
+
+  /* the event pool */
+  struct evslab *evslabs;     /* all slabs allocated so far */
+  struct event *evfree;       /* free events, linked by next */
+  int evlive;                 /* number of events currently allocated */
+
+  /* the packet buffer pool */
+  size_t pktstride;           /* bytes per buffer, see pktsize() */
+  struct pktslab *pktslabs;
+  struct freepkt *pktfree;
+  struct msg *message;        /* the message being given to layer 4 */
+
+  /* logical timers */
+  struct idtimer *wheel[WHEELSLOTS];
+  int wheelcount;             /* number of timers in the wheel */
+  struct event *wheelev;      /* the queued WHEEL_TICK event */
+
+  const struct protocol *protocol;  /* the engine the flows run */
+  struct flow *flows;         /* params.nflows of them */
+  struct flow *curflow;       /* the flow whose entity is being run */
+  struct channel channels[2]; /* the medium shared by all flows, if they
+                                 have a bottleneck */
+  struct tracebuf *trace;     /* binary trace, NULL if not wanted */
+  struct metrics metrics;     /* end to end latency and occupancy */
+};
+
+/* the simulation being run by this thread, for the routines the
+   protocol entities call */
+static _Thread_local struct sim_context *cursim = NULL;
+
+_Thread_local int TRACE = 3;
 
 /****************************************************************************/
-/* jimsrand(): return a double in range [0,1].  The routine below is used to */
-/* isolate all random number generation in one location.  We assume that the*/
-/* system-supplied rand() function return an int in therange [0,mmm]        */
+/* jimsrand(): return a double in range [0,1).  The routines below are used */
+/* to isolate all random number generation in one location.  Every stream   */
+/* of a simulation is a xoshiro256+ generator; the streams are 2^128 draws  */
+/* apart in the same sequence, so they never overlap.  Uniforms are made a  */
+/* block at a time, which keeps the generator's loop tight.                 */
 /****************************************************************************/
-double jimsrand(void) 
+static uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t xoshiro(uint64_t s[4])
+{
+  uint64_t result = s[0] + s[3];
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+/* advance s by 2^128 draws */
+static void xoshirojump(uint64_t s[4])
+{
+  static const uint64_t jump[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  uint64_t t[4] = { 0, 0, 0, 0 };
+  int i, b, k;
+
+  for (i=0; i<4; i++)
+    for (b=0; b<64; b++) {
+      if (jump[i] & ((uint64_t)1 << b))
+        for (k=0; k<4; k++)
+          t[k] ^= s[k];
+      xoshiro(s);
+    }
+  for (k=0; k<4; k++)
+    s[k] = t[k];
+}
+
+/* seed every stream of the simulation from seed */
+static void seedrng(struct sim_context *sim, unsigned long seed)
+{
+  uint64_t z, x = seed;
+  int i, k;
+
+  for (k=0; k<4; k++) {          /* splitmix64 spreads the seed over the state */
+    z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    sim->rng[0].s[k] = z ^ (z >> 31);
+  }
+  for (i=0; i<NRNGSTREAMS; i++) {
+    if (i > 0) {
+      for (k=0; k<4; k++)
+        sim->rng[i].s[k] = sim->rng[i-1].s[k];
+      xoshirojump(sim->rng[i].s);
+    }
+    sim->rng[i].next = RNGBLOCK;   /* block is empty */
+  }
+}
+
+/* refill the block of uniforms of a stream */
+static void fillblock(struct rngstream *r)
+{
+  int i;
+
+  for (i=0; i<RNGBLOCK; i++)
+    r->block[i] = (xoshiro(r->s) >> 11) * 0x1.0p-53;  /* top 53 bits */
+  r->next = 0;
+}
+
+double jimsrand(struct sim_context *sim, int stream) 
 {
-  double mmm = RAND_MAX;     /* largest int  - MACHINE DEPENDENT!!!!!!!!   */
-  double x;                   
-  x = rand()/mmm;            /* x should be uniform in [0,1] */
-  if (TRACE > 3)
+  struct rngstream *r = &sim->rng[stream];
+  double x;
+
+  if (r->next == RNGBLOCK)
+    fillblock(r);
+  x = r->block[r->next++];     /* x should be uniform in [0,1) */
+  if (TRACING(3))
     printf("RANDOM NUMBER GENERAION CALLED: %f\n", x);
   return(x);
 }  
 
+/********************* BINARY TRACE ROUTINES *******/
+
+static void traceflush(struct sim_context *sim)
+{
+  struct tracebuf *tb = sim->trace;
+
+  if (tb->count > 0 &&
+      fwrite(tb->rec, sizeof(struct tracerec), tb->count, tb->f) != (size_t)tb->count) {
+    printf("writing trace file failed.");
+    exit(EXIT_FAILURE);
+  }
+  tb->count = 0;
+}
+
+/* append a record to the binary trace, if there is one */
+static void tracerecord(struct sim_context *sim, int kind, int entity,
+                        int seqnum, int acknum, int checksum, int length, char data)
+{
+  struct tracerec *r;
+
+  if (sim->trace == NULL)
+    return;
+  if (sim->trace->count == TRACEBUF)
+    traceflush(sim);
+  r = &sim->trace->rec[sim->trace->count++];
+  r->time = sim->time;
+  r->seqnum = seqnum;
+  r->acknum = acknum;
+  r->checksum = checksum;
+  r->length = length;
+  r->kind = kind;
+  r->entity = entity;
+  r->data = data;
+  r->unused = 0;
+  r->flow = sim->curflow - sim->flows;
+}
+
+static void traceopen(struct sim_context *sim, const char *name)
+{
+  sim->trace = malloc(sizeof(struct tracebuf));
+  if (sim->trace == 0) {
+    printf("memory allocation for trace failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->trace->count = 0;
+  sim->trace->f = fopen(name, "wb");
+  if (sim->trace->f == NULL) {
+    printf("cannot open trace file %s.", name);
+    exit(EXIT_FAILURE);
+  }
+  fwrite(TRACEMAGIC, 1, 8, sim->trace->f);
+}
+
+static void traceclose(struct sim_context *sim)
+{
+  if (sim->trace == NULL)
+    return;
+  traceflush(sim);
+  if (fclose(sim->trace->f) != 0) {
+    printf("writing trace file failed.");
+    exit(EXIT_FAILURE);
+  }
+  free(sim->trace);
+  sim->trace = NULL;
+}
+
 /********************* EVENT HANDLINE ROUTINES *******/
 /*  The next set of routines handle the event list   */
 /*****************************************************/
 
-void insertevent(struct event *p)
+#if EVQUEUE == EVQUEUE_HEAP
+/* returns true if event p must be simulated before event q.  Events with
+   equal times are taken newest first, which is the order the sorted list
+   has always produced (a new event goes in front of any equal ones). */
+static int evbefore(const struct event *p, const struct event *q)
+{
+  if (p->evtime != q->evtime)
+    return (p->evtime < q->evtime);
+  return (p->evseq > q->evseq);
+}
+
+static void heapplace(struct sim_context *sim, struct event *p, int i)
+{
+  sim->evheap[i] = p;
+  p->heapidx = i;
+}
+
+static void siftup(struct sim_context *sim, int i)
+{
+  struct event *p = sim->evheap[i];
+  int parent;
+
+  while (i > 0) {
+    parent = (i-1) / HEAPARITY;
+    if (!evbefore(p, sim->evheap[parent]))
+      break;
+    heapplace(sim, sim->evheap[parent], i);
+    i = parent;
+  }
+  heapplace(sim, p, i);
+}
+
+static void siftdown(struct sim_context *sim, int i)
 {
+  struct event *p = sim->evheap[i];
+  int child, best, last;
+
+  for (;;) {
+    child = i*HEAPARITY + 1;
+    if (child >= sim->evcount)
+      break;
+    last = child + HEAPARITY;
+    if (last > sim->evcount)
+      last = sim->evcount;
+    for (best = child++; child < last; child++)
+      if (evbefore(sim->evheap[child], sim->evheap[best]))
+        best = child;
+    if (!evbefore(sim->evheap[best], p))
+      break;
+    heapplace(sim, sim->evheap[best], i);
+    i = best;
+  }
+  heapplace(sim, p, i);
+}
+#endif
+
+void insertevent(struct sim_context *sim, struct event *p)
+{
+#if EVQUEUE == EVQUEUE_LIST
   struct event *q,*qold;
+#else
+  struct event **newheap;
+#endif
 
-  if (TRACE>2) {
-    printf("            INSERTEVENT: time is %f\n",time);
+  if (TRACING(2)) {
+    printf("            INSERTEVENT: time is %f\n",sim->time);
     printf("            INSERTEVENT: future time will be %f\n",p->evtime); 
   }
-  q = evlist;     /* q points to front of list in which p struct inserted */
+  p->evseq = sim->evseqnext++;
+#if EVQUEUE == EVQUEUE_LIST
+  q = sim->evlist;     /* q points to front of list in which p struct inserted */
   if (q==NULL) {   /* list is empty */
-    evlist=p;
+    sim->evlist=p;
     p->next=NULL;
     p->prev=NULL;
   }
@@ -126,11 +475,11 @@ void insertevent(struct event *p)
       p->prev = qold;
       p->next = NULL;
     }
-    else if (q==evlist) { /* front of list */
-      p->next=evlist;
+    else if (q==sim->evlist) { /* front of list */
+      p->next=sim->evlist;
       p->prev=NULL;
       p->next->prev=p;
-      evlist = p;
+      sim->evlist = p;
     }
     else {     /* middle of list */
       p->next=q;
@@ -139,94 +488,245 @@ void insertevent(struct event *p)
       q->prev=p;
     }
   }
+#else
+  if (sim->evcount == sim->evcapacity) {
+    sim->evcapacity = (sim->evcapacity == 0) ? 64 : 2*sim->evcapacity;
+    newheap = realloc(sim->evheap, sim->evcapacity * sizeof(struct event *));
+    if (newheap == 0) {
+      printf("memory allocation for event failed.");
+      exit(EXIT_FAILURE);
+    }
+    sim->evheap = newheap;
+  }
+  sim->evheap[sim->evcount] = p;
+  siftup(sim, sim->evcount++);
+#endif
 }
 
-void generate_next_arrival(void)
+/* unlink event p, which must currently be queued */
+static void removeevent(struct sim_context *sim, struct event *p)
+{
+#if EVQUEUE == EVQUEUE_LIST
+  if (p->next==NULL && p->prev==NULL)
+    sim->evlist=NULL;         /* remove first and only event on list */
+  else if (p->next==NULL) /* end of list - there is one in front */
+    p->prev->next = NULL;
+  else if (p==sim->evlist) { /* front of list - there must be event after */
+    p->next->prev=NULL;
+    sim->evlist = p->next;
+  }
+  else {     /* middle of list */
+    p->next->prev = p->prev;
+    p->prev->next =  p->next;
+  }
+#else
+  int i = p->heapidx;
+
+  sim->evcount--;
+  if (i == sim->evcount)
+    return;
+  heapplace(sim, sim->evheap[sim->evcount], i);
+  if (i > 0 && evbefore(sim->evheap[i], sim->evheap[(i-1) / HEAPARITY]))
+    siftup(sim, i);
+  else
+    siftdown(sim, i);
+#endif
+}
+
+/* remove and return the next event to simulate, NULL if there are none */
+static struct event *popevent(struct sim_context *sim)
+{
+  struct event *p;
+
+#if EVQUEUE == EVQUEUE_LIST
+  p = sim->evlist;
+#else
+  p = (sim->evcount > 0) ? sim->evheap[0] : NULL;
+#endif
+  if (p != NULL)
+    removeevent(sim, p);
+  return p;
+}
+
+/* get an event from the free list, growing the pool by a slab if empty */
+static struct event *newevent(struct sim_context *sim)
+{
+  struct evslab *slab;
+  struct event *p;
+  int i;
+
+  if (sim->evfree == NULL) {
+    slab = malloc(sizeof(struct evslab));
+    if (slab == 0) {
+      printf("memory allocation for event failed.");
+      exit(EXIT_FAILURE);
+    }
+    slab->next = sim->evslabs;
+    sim->evslabs = slab;
+    sim->stats.nevslabs++;
+    for (i=EVSLABSIZE-1; i>=0; i--) {
+      slab->events[i].next = sim->evfree;
+      sim->evfree = &slab->events[i];
+    }
+  }
+  p = sim->evfree;
+  sim->evfree = p->next;
+  p->pkt = NULL;
+  p->evflow = 0;
+  if (++sim->evlive > sim->stats.evpeak)
+    sim->stats.evpeak = sim->evlive;
+  return p;
+}
+
+/* get a packet buffer from the free list, growing the pool if empty */
+static struct pkt *newpkt(struct sim_context *sim)
+{
+  struct pktslab *slab;
+  struct freepkt *f;
+  char *buf;
+  int i;
+
+  if (sim->pktfree == NULL) {
+    slab = malloc(sizeof(struct pktslab) + PKTSLABSIZE * sim->pktstride);
+    if (slab == 0) {
+      printf("memory allocation for packet failed.");
+      exit(EXIT_FAILURE);
+    }
+    slab->next = sim->pktslabs;
+    sim->pktslabs = slab;
+    buf = (char *)(slab + 1);
+    for (i=PKTSLABSIZE-1; i>=0; i--) {
+      f = (struct freepkt *)(buf + i * sim->pktstride);
+      f->next = sim->pktfree;
+      sim->pktfree = f;
+    }
+  }
+  f = sim->pktfree;
+  sim->pktfree = f->next;
+  return (struct pkt *)f;
+}
+
+static void freepkt(struct sim_context *sim, struct pkt *p)
+{
+  struct freepkt *f = (struct freepkt *)p;
+
+  f->next = sim->pktfree;
+  sim->pktfree = f;
+}
+
+/* return an event (no longer queued) to the free list */
+static void freeevent(struct sim_context *sim, struct event *p)
+{
+  if (p->pkt != NULL)
+    freepkt(sim, p->pkt);
+  p->next = sim->evfree;
+  sim->evfree = p;
+  sim->evlive--;
+}
+
+/* release every slab at once; all events and packets become invalid */
+static void freeevents(struct sim_context *sim)
+{
+  struct evslab *slab;
+  struct pktslab *pslab;
+
+  while (sim->evslabs != NULL) {
+    slab = sim->evslabs;
+    sim->evslabs = slab->next;
+    free(slab);
+  }
+  sim->evfree = NULL;
+  sim->evlive = 0;
+  while (sim->pktslabs != NULL) {
+    pslab = sim->pktslabs;
+    sim->pktslabs = pslab->next;
+    free(pslab);
+  }
+  sim->pktfree = NULL;
+}
+
+/* reschedule queued event p to newtime without taking it off the queue
+   and putting it back, as if it had just been inserted */
+static void moveevent(struct sim_context *sim, struct event *p, double newtime)
+{
+  if (TRACING(2)) {
+    printf("            MOVEEVENT: time is %f\n",sim->time);
+    printf("            MOVEEVENT: future time will be %f\n",newtime);
+  }
+#if EVQUEUE == EVQUEUE_LIST
+  removeevent(sim, p);
+  p->evtime = newtime;
+  insertevent(sim, p);
+#else
+  p->evtime = newtime;
+  p->evseq = sim->evseqnext++;
+  if (p->heapidx > 0 && evbefore(p, sim->evheap[(p->heapidx-1) / HEAPARITY]))
+    siftup(sim, p->heapidx);
+  else
+    siftdown(sim, p->heapidx);
+#endif
+}
+
+/* the next message arrival of the current flow; every flow has its own
+   arrivals */
+void generate_next_arrival(struct sim_context *sim)
 {
   double x;
   struct event *evptr;
 
-  if (TRACE>2)
+  if (TRACING(2))
     printf("          GENERATE NEXT ARRIVAL: creating new arrival\n");
+  tracerecord(sim, TR_ARRIVAL, A, 0, 0, 0, 0, 0);
  
-  x = lambda*jimsrand()*2;  /* x is uniform on [0,2*lambda] */
+  x = sim->params.lambda*jimsrand(sim, RNG_ARRIVAL)*2;  /* x is uniform on [0,2*lambda] */
   /* having mean of lambda        */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  evptr->evtime =  time + x;
+  evptr = newevent(sim);
+  evptr->evtime =  sim->time + x;
   evptr->evtype =  FROM_LAYER5;
-  if (BIDIRECTIONAL && (jimsrand()>0.5) )
+  evptr->evflow = sim->curflow - sim->flows;
+  if (sim->params.bidirectional && (jimsrand(sim, RNG_ARRIVAL)>0.5) )
     evptr->eventity = B;
   else
     evptr->eventity = A;
-  insertevent(evptr);
+  insertevent(sim, evptr);
 } 
 
-void printevlist(void)
+void printevlist(struct sim_context *sim)
 {
   struct event *q;
+#if EVQUEUE == EVQUEUE_HEAP
+  int i;
+#endif
   printf("--------------\nEvent List Follows:\n");
-  for(q = evlist; q!=NULL; q=q->next) {
+#if EVQUEUE == EVQUEUE_LIST
+  for(q = sim->evlist; q!=NULL; q=q->next) {
+#else
+  for(i = 0; i < sim->evcount; i++) {  /* heap order, not time order */
+    q = sim->evheap[i];
+#endif
     printf("Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
   }
   printf("--------------\n");
 }
 
-void init(void)                         /* initialize the simulator */
+void init(struct sim_params *params)     /* ask for the simulation parameters */
 {
-  float sum, avg;
-  int i;
-
   printf("-----  Stop and Wait Network Simulator Version 1.1 -------- \n\n");
   printf("Enter the number of messages to simulate: ");
-  scanf("%d",&nsimmax);
+  scanf("%d",&params->nsimmax);
   printf("Enter  packet loss probability [enter 0.0 for no loss]:");
-  scanf("%f",&lossprob);
+  scanf("%f",&params->lossprob);
   printf("Enter packet corruption probability [0.0 for no corruption]:");
-  scanf("%f",&corruptprob);
-  if (lossprob != 0.0 || corruptprob != 0.0) {
+  scanf("%f",&params->corruptprob);
+  params->corruptdirection = 0;
+  if (params->lossprob != 0.0 || params->corruptprob != 0.0) {
     printf("If you want loss or corruption to only occur in one direction, choose the direction: 0 A->B, 1 A<-B, 2 A<->B (both directions) :");
-    scanf("%d",&corruptdirection);
+    scanf("%d",&params->corruptdirection);
   }
   printf("Enter average time between messages from sender's layer5 [ > 0.0]:");
-  scanf("%f",&lambda);
+  scanf("%f",&params->lambda);
   printf("Enter TRACE:");
-  scanf("%d",&TRACE);
-
-
-  srand(9999);              /* init random number generator */
-  sum = 0.0;                /* test random number generator for students */
-  for (i=0; i<1000; i++)
-    sum+=jimsrand();    /* jimsrand() should be uniform in [0,1] */
-  avg = sum/1000.0;
-  if (avg < 0.25 || avg > 0.75) {
-    printf("It is likely that random number generation on your machine\n" ); 
-    printf("is different from what this emulator expects.  Please take\n");
-    printf("a look at the routine jimsrand() in the emulator code. Sorry. \n");
-    exit(EXIT_FAILURE);
-  }
-
-  /* initialise statistics */
-  window_full = 0;
-  total_ACKs_received = 0;
-  packets_resent = 0;
-  new_ACKs = 0;
-  packets_received = 0;
-  packets_lost = 0;  
-  packets_corrupt = 0;
-  packets_sent = 0;
-  packets_timeout = 0;
-  messages_delivered = 0;
-
-  ntolayer3 = 0;
-  nlost = 0;
-  ncorrupt = 0;
-
-  time=0.0;                    /* initialize time to 0.0 */
-  generate_next_arrival();     /* initialize event list */
+  scanf("%d",&params->trace);
 }
 
 /********************** Student-callable ROUTINES ***********************/
@@ -235,29 +735,21 @@ void init(void)                         /* initialize the simulator */
 void stoptimer(int AorB)
 /* A or B is trying to stop timer */
 {
+  struct sim_context *sim = cursim;
+  struct flow *f = sim->curflow;
   struct event *q;
 
-  if (TRACE>1)
-    printf("          STOP TIMER: stopping timer at %f\n",time);
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-  for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
-      /* remove this event */
-      if (q->next==NULL && q->prev==NULL)
-        evlist=NULL;         /* remove first and only event on list */
-      else if (q->next==NULL) /* end of list - there is one in front */
-        q->prev->next = NULL;
-      else if (q==evlist) { /* front of list - there must be event after */
-        q->next->prev=NULL;
-        evlist = q->next;
-      }
-      else {     /* middle of list */
-        q->next->prev = q->prev;
-        q->prev->next =  q->next;
-      }
-      free(q);
-      return;
-    }
+  if (TRACING(1))
+    printf("          STOP TIMER: stopping timer at %f\n",sim->time);
+  tracerecord(sim, TR_STOPTIMER, AorB, -1, 0, 0, 0, 0);
+  q = f->timers[AorB];
+  if (q != NULL) {
+    /* remove this event */
+    removeevent(sim, q);
+    freeevent(sim, q);
+    f->timers[AorB] = NULL;
+    return;
+  }
   printf("Warning: unable to cancel your timer. It wasn't running.\n");
 }
 
@@ -265,214 +757,1035 @@ void stoptimer(int AorB)
 void starttimer(int AorB, double increment)
 /* A or B is trying to start timer */
 {
-
-  struct event *q;
+  struct sim_context *sim = cursim;
+  struct flow *f = sim->curflow;
   struct event *evptr;
 
-  if (TRACE>1)
-    printf("          START TIMER: starting timer at %f\n",time);
+  if (TRACING(1))
+    printf("          START TIMER: starting timer at %f\n",sim->time);
+  tracerecord(sim, TR_STARTTIMER, AorB, -1, 0, 0, 0, 0);
   /* be nice: check to see if timer is already started, if so, then  warn */
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-  for (q=evlist; q!=NULL ; q = q->next)  
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
-      printf("Warning: attempt to start a timer that is already started\n");
-      return;
-    }
+  if (f->timers[AorB] != NULL) {
+    printf("Warning: attempt to start a timer that is already started\n");
+    return;
+  }
  
   /* create future event for when timer goes off */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  evptr->evtime =  time + increment;
+  evptr = newevent(sim);
+  evptr->evtime =  sim->time + increment;
   evptr->evtype =  TIMER_INTERRUPT;
    
  
   evptr->eventity = AorB;
-  insertevent(evptr);
+  evptr->evflow = f - sim->flows;
+  insertevent(sim, evptr);
+  f->timers[AorB] = evptr;
 } 
 
+/* called by students routine to move a running timer's deadline to
+   increment from now; starts the timer if it isn't running */
+void restarttimer(int AorB, double increment)
+/* A or B is trying to restart timer */
+{
+  struct sim_context *sim = cursim;
+  struct flow *f = sim->curflow;
+
+  if (f->timers[AorB] == NULL) {
+    starttimer(AorB, increment);
+    return;
+  }
+  if (TRACING(1))
+    printf("          RESTART TIMER: restarting timer at %f\n",sim->time);
+  tracerecord(sim, TR_RESTARTTIMER, AorB, -1, 0, 0, 0, 0);
+  moveevent(sim, f->timers[AorB], sim->time + increment);
+}
+
+
+/* return logical timer id at A or B of the current flow, NULL if it has
+   never been started; if create is set the timer is allocated (stopped)
+   when needed */
+static struct idtimer *findidtimer(struct sim_context *sim, int AorB, int timerid, int create)
+{
+  struct flow *f = sim->curflow;
+  struct idtimer **chunks;
+  int chunk = timerid / IDCHUNK;
+  int n, i;
+
+  if (timerid < 0) {
+    printf("Warning: logical timer id %d is not valid.\n", timerid);
+    return NULL;
+  }
+  if (chunk >= f->nidchunks[AorB]) {
+    if (!create)
+      return NULL;
+    n = 2*chunk + 1;
+    chunks = realloc(f->idtimers[AorB], n * sizeof(struct idtimer *));
+    if (chunks == 0) {
+      printf("memory allocation for timer failed.");
+      exit(EXIT_FAILURE);
+    }
+    for (i=f->nidchunks[AorB]; i<n; i++)
+      chunks[i] = NULL;
+    f->idtimers[AorB] = chunks;
+    f->nidchunks[AorB] = n;
+  }
+  if (f->idtimers[AorB][chunk] == NULL) {
+    if (!create)
+      return NULL;
+    f->idtimers[AorB][chunk] = calloc(IDCHUNK, sizeof(struct idtimer));
+    if (f->idtimers[AorB][chunk] == 0) {
+      printf("memory allocation for timer failed.");
+      exit(EXIT_FAILURE);
+    }
+    for (i=0; i<IDCHUNK; i++) {
+      f->idtimers[AorB][chunk][i].flow = f - sim->flows;
+      f->idtimers[AorB][chunk][i].entity = AorB;
+      f->idtimers[AorB][chunk][i].timerid = chunk*IDCHUNK + i;
+    }
+  }
+  return &f->idtimers[AorB][chunk][timerid % IDCHUNK];
+}
+
+/* put logical timer t on the event queue to go off at its expiry */
+static void queueidtimer(struct sim_context *sim, struct idtimer *t)
+{
+  struct event *evptr;
+
+  evptr = newevent(sim);
+  evptr->evtime = t->expiry;
+  evptr->evtype = IDTIMER_INTERRUPT;
+  evptr->eventity = t->entity;
+  evptr->evflow = t->flow;
+  evptr->evtimerid = t->timerid;
+  insertevent(sim, evptr);
+  t->ev = evptr;
+  t->state = IDTIMER_QUEUED;
+}
+
+/* make sure the WHEEL_TICK event goes off no later than tick */
+static void schedulewheel(struct sim_context *sim, long tick)
+{
+  double ticktime = tick * WHEELTICK;
+
+  if (sim->wheelev == NULL) {
+    sim->wheelev = newevent(sim);
+    sim->wheelev->evtime = ticktime;
+    sim->wheelev->evtype = WHEEL_TICK;
+    sim->wheelev->eventity = A;
+    insertevent(sim, sim->wheelev);
+  }
+  else if (ticktime < sim->wheelev->evtime)
+    moveevent(sim, sim->wheelev, ticktime);
+}
+
+/* called when the WHEEL_TICK event goes off: queue the timers due in the
+   current slot and schedule the tick for the next occupied slot */
+static void advancewheel(struct sim_context *sim)
+{
+  struct idtimer *t, *tnext;
+  long tick = (long)(sim->time / WHEELTICK);
+  int slot = tick & (WHEELSLOTS-1);
+  int i;
+
+  sim->wheelev = NULL;
+  for (t = sim->wheel[slot]; t != NULL; t = tnext) {
+    tnext = t->next;
+    if (t->tick != tick)
+      continue;            /* due in a later turn of the wheel */
+    if (t->prev == NULL)
+      sim->wheel[slot] = t->next;
+    else
+      t->prev->next = t->next;
+    if (t->next != NULL)
+      t->next->prev = t->prev;
+    sim->wheelcount--;
+    queueidtimer(sim, t);
+  }
+  if (sim->wheelcount > 0)
+    for (i = 1; i <= WHEELSLOTS; i++)
+      if (sim->wheel[(tick + i) & (WHEELSLOTS-1)] != NULL) {
+        schedulewheel(sim, tick + i);
+        break;
+      }
+}
+
+/* called by students routine to start logical timer id at A or B.  An
+   entity can run any number of logical timers alongside its timer; when
+   one goes off the protocol's idtimerinterrupt() is called with the
+   entity and its id */
+void startidtimer(int AorB, int timerid, double increment)
+/* A or B is trying to start timer timerid */
+{
+  struct sim_context *sim = cursim;
+  struct idtimer *t;
+  int slot;
+
+  if (TRACING(1))
+    printf("          START TIMER %d: starting timer at %f\n",timerid,sim->time);
+  tracerecord(sim, TR_STARTTIMER, AorB, timerid, 0, 0, 0, 0);
+  t = findidtimer(sim, AorB, timerid, 1);
+  if (t == NULL)
+    return;
+  if (t->state != IDTIMER_OFF) {
+    printf("Warning: attempt to start a timer that is already started\n");
+    return;
+  }
+  t->expiry = sim->time + increment;
+  t->tick = (long)(t->expiry / WHEELTICK);
+  if (t->tick <= (long)(sim->time / WHEELTICK)) {
+    queueidtimer(sim, t);       /* goes off within the current tick */
+    return;
+  }
+  slot = t->tick & (WHEELSLOTS-1);
+  t->prev = NULL;
+  t->next = sim->wheel[slot];
+  if (t->next != NULL)
+    t->next->prev = t;
+  sim->wheel[slot] = t;
+  t->state = IDTIMER_WHEEL;
+  sim->wheelcount++;
+  schedulewheel(sim, t->tick);
+}
+
+/* called by students routine to cancel logical timer id at A or B */
+void stopidtimer(int AorB, int timerid)
+/* A or B is trying to stop timer timerid */
+{
+  struct sim_context *sim = cursim;
+  struct idtimer *t;
+
+  if (TRACING(1))
+    printf("          STOP TIMER %d: stopping timer at %f\n",timerid,sim->time);
+  tracerecord(sim, TR_STOPTIMER, AorB, timerid, 0, 0, 0, 0);
+  t = findidtimer(sim, AorB, timerid, 0);
+  if (t == NULL || t->state == IDTIMER_OFF) {
+    printf("Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+  }
+  if (t->state == IDTIMER_WHEEL) {
+    if (t->prev == NULL)
+      sim->wheel[t->tick & (WHEELSLOTS-1)] = t->next;
+    else
+      t->prev->next = t->next;
+    if (t->next != NULL)
+      t->next->prev = t->prev;
+    sim->wheelcount--;
+
+    /* with no timers left on the wheel its tick would only hold the end
+       of the simulation back */
+    if (sim->wheelcount == 0 && sim->wheelev != NULL) {
+      removeevent(sim, sim->wheelev);
+      freeevent(sim, sim->wheelev);
+      sim->wheelev = NULL;
+    }
+  }
+  else {
+    removeevent(sim, t->ev);
+    freeevent(sim, t->ev);
+    t->ev = NULL;
+  }
+  t->state = IDTIMER_OFF;
+}
+
+/* returns 1 if logical timer id at A or B is running, 0 otherwise */
+int idtimerrunning(int AorB, int timerid)
+{
+  struct idtimer *t = findidtimer(cursim, AorB, timerid, 0);
+
+  return (t != NULL && t->state != IDTIMER_OFF);
+}
+
+/* release the logical timers of A and B of every flow */
+static void freeidtimers(struct sim_context *sim)
+{
+  struct flow *f;
+  int AorB, i;
+
+  for (f = sim->flows; f < sim->flows + sim->params.nflows; f++)
+    for (AorB = A; AorB <= B; AorB++) {
+      for (i = 0; i < f->nidchunks[AorB]; i++)
+        free(f->idtimers[AorB][i]);
+      free(f->idtimers[AorB]);
+      f->idtimers[AorB] = NULL;
+      f->nidchunks[AorB] = 0;
+    }
+  for (i = 0; i < WHEELSLOTS; i++)
+    sim->wheel[i] = NULL;
+  sim->wheelcount = 0;
+  sim->wheelev = NULL;
+}
+
+
+/* the medium carrying flow f's packets towards entity */
+static struct channel *medium(struct sim_context *sim, struct flow *f, int entity)
+{
+  return sim->params.bottleneck ? &sim->channels[entity] : &f->channels[entity];
+}
+
+/* 1 if packets sent by AorB are impaired in direction, which is 0 for
+   A->B, 1 for A<-B and 2 for both */
+static int impaired(int AorB, int direction)
+{
+  return !(AorB == B && direction == A) && !(AorB == A && direction == B);
+}
+
+/* 1 if a packet sent by AorB into ch is lost.  Losses are independent,
+   or with the Gilbert-Elliott model they come in bursts: before each
+   packet the channel turns bad with probability burstprob, or good again
+   with burstend, and it loses packets with probability lossprob while
+   it is good and burstloss while it is bad */
+static int lost(struct sim_context *sim, struct channel *ch, int AorB)
+{
+  float prob = sim->params.lossprob;
+
+  if (sim->params.burstprob > 0.0) {
+    if (jimsrand(sim, RNG_BURST) < (ch->bad ? sim->params.burstend : sim->params.burstprob))
+      ch->bad = !ch->bad;
+    if (ch->bad)
+      prob = sim->params.burstloss;
+  }
+  return jimsrand(sim, RNG_LOSS) < prob && impaired(AorB, sim->params.corruptdirection);
+}
 
 /************************** TOLAYER3 ***************/
-void tolayer3(int AorB, struct pkt packet)
+/* simulate corruption of p, sent by AorB in flow f */
+static void corrupt(struct sim_context *sim, struct flow *f, int AorB, struct pkt *p)
+{
+  double x;
+
+  if ((jimsrand(sim, RNG_CORRUPT) < sim->params.corruptprob)  && impaired(AorB, sim->params.corruptdirection)) {
+    f->stats.ncorrupt++;
+    if ( (x = jimsrand(sim, RNG_CORRUPT)) < .75) {
+      if (p->length > 0)
+        p->payload[0]='Z';   /* corrupt payload */
+      else
+        p->acknum = 999999;  /* no payload, hit the header */
+    }
+    else if (x < .875)
+      p->seqnum = 999999;
+    else
+      p->acknum = 999999;
+    if (TRACING(0))    
+      printf("          TOLAYER3: packet being corrupted\n");
+    tracerecord(sim, TR_CORRUPT, AorB, 0, 0, 0, 0, 0);
+  }  
+}
+
+void tolayer3(int AorB, const struct pkt *packet)
 /* A or B is sending to network  */
 {
+  struct sim_context *sim = cursim;
+  struct flow *f = sim->curflow;
+  struct channel *ch;
   struct pkt *mypktptr;
-  struct event *evptr,*q;
-  float lastime, x;
+  struct event *evptr, *copy;
+  double lastime, arrival = 0.0, wait;
   int i;
 
-  ntolayer3++;
+  if (packet->length < 0 || packet->length > sim->params.payloadsize) {
+    printf("Warning: packet with %d bytes of payload not sent, the payload size is %d.\n",
+           packet->length, sim->params.payloadsize);
+    return;
+  }
+  f->stats.ntolayer3++;
 
   /* simulate losses: */
-  if (jimsrand() < lossprob && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B))) {
-    nlost++;
-    if (TRACE>0)    
+  ch = medium(sim, f, (AorB+1) % 2);
+  if (lost(sim, ch, AorB)) {
+    f->stats.nlost++;
+    if (TRACING(0))    
       printf("          TOLAYER3: packet being lost\n");
+    tracerecord(sim, TR_LOST, AorB, 0, 0, 0, 0, 0);
     return;
   }  
 
+  /* a link of limited bandwidth has its router queue to get through */
+  if (sim->params.bandwidth > 0.0) {
+    arrival = linksend(&ch->link, sim->time, offsetof(struct pkt, payload) + packet->length,
+                       sim->params.aqm == QUEUE_RED ? jimsrand(sim, RNG_QUEUE) : 0.0, &wait);
+    if (arrival < 0.0) {
+      f->stats.queue_drops++;
+      if (TRACING(0))
+        printf("          TOLAYER3: packet dropped by the router queue\n");
+      tracerecord(sim, TR_DROP, AorB, ch->link.count, 0, 0, 0, 0);
+      return;
+    }
+    f->stats.queue_wait += wait;
+  }
+
+  /* create future event for arrival of packet at the other side */
+  evptr = newevent(sim);
+
   /* make a copy of the packet student just gave me since he/she may decide */
   /* to do something with the packet after we return back to him/her */ 
-  mypktptr = malloc(sizeof(struct pkt));
-  if (mypktptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  mypktptr->seqnum = packet.seqnum;
-  mypktptr->acknum = packet.acknum;
-  mypktptr->checksum = packet.checksum;
-  for (i=0; i<20; i++)
-    mypktptr->payload[i] = packet.payload[i];
-  if (TRACE>2)  {
+  mypktptr = evptr->pkt = newpkt(sim);
+  memcpy(mypktptr, packet, offsetof(struct pkt, payload) + packet->length);
+  if (TRACING(2))  {
     printf("          TOLAYER3: seq: %d, ack %d, check: %d ", mypktptr->seqnum,
            mypktptr->acknum,  mypktptr->checksum);
-    for (i=0; i<20; i++)
+    for (i=0; i<mypktptr->length; i++)
       printf("%c",mypktptr->payload[i]);
     printf("\n");
   }
+  tracerecord(sim, TR_TOLAYER3, AorB, mypktptr->seqnum, mypktptr->acknum,
+              mypktptr->checksum, mypktptr->length,
+              mypktptr->length > 0 ? mypktptr->payload[0] : 0);
 
-  /* create future event for arrival of packet at the other side */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
   evptr->evtype =  FROM_LAYER3;   /* packet will pop out from layer3 */
   evptr->eventity = (AorB+1) % 2; /* event occurs at other entity */
-  evptr->pktptr = mypktptr;       /* save ptr to my copy of packet */
+  evptr->evflow = f - sim->flows;
   /* finally, compute the arrival time of packet at the other end.
-     medium can not reorder, so make sure packet arrives between 1 and 10
-     time units after the latest arrival time of packets
-     currently in the medium on their way to the destination */
-  lastime = time;
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next) */
-  for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==FROM_LAYER3  && q->eventity==evptr->eventity) ) 
-      lastime = q->evtime;
-  evptr->evtime =  lastime + 1 + 9*jimsrand();
+     By default the medium keeps packets in order, so make sure packet
+     arrives between 1 and 10 time units after the latest arrival time of
+     packets currently in the medium on their way to the destination.
+     Flows sharing a bottleneck queue up behind each other's packets.  A
+     link of limited bandwidth has worked out the arrival time already.
+     Only reordering (held back below) and duplication deliver packets
+     out of order */
+  if (sim->params.bandwidth > 0.0)
+    evptr->evtime = arrival;
+  else {
+    lastime = sim->time;
+    if (ch->inflight > 0 && ch->lastarrival > lastime)
+      lastime = ch->lastarrival;
+    evptr->evtime =  lastime + 1 + 9*jimsrand(sim, RNG_DELAY);
+  }
+
+  /* unless the packet is held back for up to reorderdelay more, letting
+     the packets sent after it get there first */
+  if (sim->params.reorderprob > 0.0 && jimsrand(sim, RNG_REORDER) < sim->params.reorderprob &&
+      impaired(AorB, sim->params.reorderdirection)) {
+    f->stats.nreordered++;
+    if (TRACING(0))
+      printf("          TOLAYER3: packet being held back\n");
+    tracerecord(sim, TR_REORDER, AorB, 0, 0, 0, 0, 0);
+    evptr->evtime += sim->params.reorderdelay * jimsrand(sim, RNG_REORDER);
+  }
+  else
+    ch->lastarrival = evptr->evtime;
+  ch->inflight++;
+  metricsinflight(&sim->metrics, 1, sim->time);
  
 
 
-  /* simulate corruption: */
-  if ((jimsrand() < corruptprob)  && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B))) {
-    ncorrupt++;
-    if ( (x = jimsrand()) < .75)
-      mypktptr->payload[0]='Z';   /* corrupt payload */
-    else if (x < .875)
-      mypktptr->seqnum = 999999;
-    else
-      mypktptr->acknum = 999999;
-    if (TRACE>0)    
-      printf("          TOLAYER3: packet being corrupted\n");
-  }  
+  corrupt(sim, f, AorB, mypktptr);
+
+  /* simulate duplication: a second copy of what was sent arrives with it,
+     copied before the first was corrupted and taking its own chances */
+  if (sim->params.dupprob > 0.0 && jimsrand(sim, RNG_DUPLICATE) < sim->params.dupprob &&
+      impaired(AorB, sim->params.dupdirection)) {
+    f->stats.nduplicated++;
+    if (TRACING(0))
+      printf("          TOLAYER3: packet being duplicated\n");
+    tracerecord(sim, TR_DUPLICATE, AorB, 0, 0, 0, 0, 0);
+    copy = newevent(sim);
+    copy->evtime = evptr->evtime;
+    copy->evtype = FROM_LAYER3;
+    copy->eventity = evptr->eventity;
+    copy->evflow = evptr->evflow;
+    copy->pkt = newpkt(sim);
+    memcpy(copy->pkt, packet, offsetof(struct pkt, payload) + packet->length);
+    corrupt(sim, f, AorB, copy->pkt);
+    insertevent(sim, copy);
+    ch->inflight++;
+    metricsinflight(&sim->metrics, 1, sim->time);
+  }
 
-  if (TRACE>2)  
+  if (TRACING(2))  
     printf("          TOLAYER3: scheduling arrival on other side\n");
-  insertevent(evptr);
+  tracerecord(sim, TR_SCHEDULE, AorB, 0, 0, 0, 0, 0);
+  insertevent(sim, evptr);
 } 
 
-void tolayer5(int AorB, char datasent[20])
+void tolayer5(int AorB, const char datasent[], int length)
 {
-  int i;  
-  if (TRACE>2) {
+  struct sim_context *sim = cursim;
+  struct flow *f = sim->curflow;
+  int i;
+  if (TRACING(2)) {
     printf("          TOLAYER5: data received by application at ");
     if (AorB == A) 
       printf("A: ");
     else
       printf("B: ");
-    for (i=0; i<20; i++)  
+    for (i=0; i<length; i++)  
       printf("%c",datasent[i]);
     printf("\n");
   }
-  messages_delivered++;
+  tracerecord(sim, TR_TOLAYER5, AorB, 0, 0, 0, length, length > 0 ? datasent[0] : 0);
+  metricsdelivered(&sim->metrics, &f->metrics, AorB, sim->time);
+  f->stats.messages_delivered++;
+  f->stats.bytes_delivered += length;
 }
 
-int main(void)
+/* the congestion control algorithm of the senders */
+int congestioncontrol(void)
+{
+  return cursim->params.congestion;
+}
+
+/* trace the congestion window of a sender, for its trajectory */
+void reportcwnd(int AorB, double cwnd, double ssthresh)
+{
+  struct sim_context *sim = cursim;
+
+  if (TRACING(2))
+    printf("          CWND: window at %c is %f, ssthresh %f\n", 'A'+AorB, cwnd, ssthresh);
+  tracerecord(sim, TR_CWND, AorB, (int)(cwnd*1000), ssthresh < 0 ? -1 : (int)(ssthresh*1000),
+              0, 0, 0);
+}
+
+/* bytes of payload a packet can carry in this simulation */
+int payloadsize(void)
+{
+  return cursim->params.payloadsize;
+}
+
+/* bytes in every message from layer 5 */
+int messagesize(void)
+{
+  return cursim->params.msgsize;
+}
+
+/* 1 if both entities send messages */
+int bidirectional(void)
+{
+  return cursim->params.bidirectional;
+}
+
+/* the window and sequence space asked for, 0 for the protocol's own */
+int windowsize(void)
+{
+  return cursim->params.windowsize;
+}
+
+int seqspace(void)
+{
+  return cursim->params.seqspace;
+}
+
+/* room in each sender's backlog */
+int backlogsize(void)
+{
+  return cursim->params.backlog;
+}
+
+/* 1 if packets may be held back, letting others past */
+int reordering(void)
+{
+  return cursim->params.reorderprob > 0.0;
+}
+
+/* 1 if the protocols estimate their retransmission timeouts */
+int adaptiverto(void)
+{
+  return cursim->params.adaptiverto;
+}
+
+/* time now in the simulation */
+double simtime(void)
+{
+  return cursim->time;
+}
+
+/* bytes needed to hold a packet with a full payload */
+size_t pktsize(void)
+{
+  return cursim->pktstride;
+}
+
+/********************** Simulation context ROUTINES ***********************/
+
+/* 0 if a simulation can be created with params, or -1, saying why on
+   stderr.  What only the protocol knows, such as whether the window fits
+   its sequence space, is checked when it starts (see sim_run()) */
+static int checkparams(const struct sim_params *params)
+{
+  if (params->payloadsize <= 0 || params->msgsize <= 0) {
+    fprintf(stderr, "payload size %d and message size %d must be positive.\n",
+            params->payloadsize, params->msgsize);
+    return -1;
+  }
+  if (params->backlog < 0) {
+    fprintf(stderr, "backlog %d must not be negative.\n", params->backlog);
+    return -1;
+  }
+  /* sequence numbers are compared by subtracting them */
+  if (params->windowsize < 0 || params->seqspace < 0 || params->seqspace > INT_MAX/2) {
+    fprintf(stderr, "window size %d and sequence space %d are not valid.\n",
+            params->windowsize, params->seqspace);
+    return -1;
+  }
+  if (params->protocol < 0 || params->protocol >= NPROTOCOLS) {
+    fprintf(stderr, "protocol %d is not known.\n", params->protocol);
+    return -1;
+  }
+  if (params->congestion < 0 || params->congestion >= NCC) {
+    fprintf(stderr, "congestion control %d is not known.\n", params->congestion);
+    return -1;
+  }
+  if (params->nflows <= 0) {
+    fprintf(stderr, "number of flows %d must be positive.\n", params->nflows);
+    return -1;
+  }
+  if (params->reorderdelay < 0.0 || params->reorderdirection < 0 || params->reorderdirection > 2 ||
+      params->dupdirection < 0 || params->dupdirection > 2) {
+    fprintf(stderr, "reordering delay %f and directions %d, %d are not valid.\n",
+            params->reorderdelay, params->reorderdirection, params->dupdirection);
+    return -1;
+  }
+  if (params->bandwidth < 0.0) {
+    fprintf(stderr, "bandwidth %f must not be negative.\n", params->bandwidth);
+    return -1;
+  }
+  if (params->bandwidth > 0.0 &&
+      !linkvalid(params->bandwidth, params->linkdelay, params->queuelimit, params->aqm)) {
+    fprintf(stderr, "link delay %f, queue %d and discipline %d are not valid.\n",
+            params->linkdelay, params->queuelimit, params->aqm);
+    return -1;
+  }
+  return 0;
+}
+
+/* create a simulation with the given parameters, ready for sim_run(), or
+   NULL if the parameters are not valid */
+struct sim_context *sim_create(const struct sim_params *params)
+{
+  struct sim_context *sim;
+  int i, j;
+
+  if (checkparams(params) < 0)
+    return NULL;
+
+  /* everything not set below starts out zero or NULL */
+  sim = calloc(1, sizeof(struct sim_context));
+  if (sim == 0) {
+    printf("memory allocation for simulation failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->params = *params;
+  /* buffers keep the alignment of a pointer, which the free list needs */
+  sim->pktstride = (offsetof(struct pkt, payload) + params->payloadsize +
+                    sizeof(void *)-1) & ~(sizeof(void *)-1);
+  sim->message = malloc(offsetof(struct msg, data) + params->msgsize);
+  if (sim->message == 0) {
+    printf("memory allocation for message failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->protocol = protocols[params->protocol];
+  sim->flows = calloc(params->nflows, sizeof(struct flow));
+  if (sim->flows == 0) {
+    printf("memory allocation for flows failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->curflow = sim->flows;
+  if (params->bandwidth > 0.0)
+    for (i=0; i<2; i++) {
+      if (params->bottleneck)
+        linkinit(&sim->channels[i].link, params->bandwidth, params->linkdelay,
+                 params->queuelimit, params->aqm);
+      else
+        for (j=0; j<params->nflows; j++)
+          linkinit(&sim->flows[j].channels[i].link, params->bandwidth, params->linkdelay,
+                   params->queuelimit, params->aqm);
+    }
+
+  seedrng(sim, params->seed);   /* init random number generator */
+  if (params->tracefile != NULL)
+    traceopen(sim, params->tracefile);
+
+  sim->time=0.0;                    /* initialize time to 0.0 */
+  return sim;
+}
+
+const struct sim_stats *sim_getstats(const struct sim_context *sim)
+{
+  return &sim->stats;
+}
+
+const struct sim_stats *sim_getflowstats(const struct sim_context *sim, int flow)
+{
+  return &sim->flows[flow].stats;
+}
+
+/* release a simulation and everything it owns */
+void sim_destroy(struct sim_context *sim)
+{
+  int i;
+
+  traceclose(sim);
+  freeidtimers(sim);
+  for (i=0; i<sim->params.nflows; i++) {
+    metricsflowfree(&sim->flows[i].metrics);
+    free(sim->flows[i].protocolstate);
+    linkfree(&sim->flows[i].channels[A].link);
+    linkfree(&sim->flows[i].channels[B].link);
+  }
+  linkfree(&sim->channels[A].link);
+  linkfree(&sim->channels[B].link);
+  free(sim->flows);
+  freeevents(sim);
+#if EVQUEUE == EVQUEUE_HEAP
+  free(sim->evheap);
+#endif
+  free(sim->message);
+  free(sim);
+}
+
+/* statistics of the flow running on this thread */
+struct sim_stats *protocolstats(void)
+{
+  return &cursim->curflow->stats;
+}
+
+/* the protocol's own state in the flow running on this thread: a block
+   of size bytes, zeroed when it is first asked for */
+void *protocolstate(size_t size)
+{
+  struct flow *f = cursim->curflow;
+
+  if (f->protocolstate == NULL) {
+    f->protocolstate = calloc(1, size);
+    if (f->protocolstate == 0) {
+      printf("memory allocation for protocol state failed.");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return f->protocolstate;
+}
+
+/* add the occupancy of link up to time to the statistics of its owner */
+static void linkstats(struct link *link, double time, struct sim_stats *st)
+{
+  linkfinish(link, time);
+  st->queue_area += link->area;
+  if (link->peak > st->queue_peak)
+    st->queue_peak = link->peak;
+}
+
+/* add the counters of every flow into the statistics of the simulation,
+   and work out the end to end metrics of each flow and of the whole */
+static void sumflows(struct sim_context *sim)
+{
+  struct sim_stats *st = &sim->stats, *fs;
+  int i;
+
+  if (sim->params.bandwidth > 0.0 && sim->params.bottleneck) {
+    linkstats(&sim->channels[A].link, sim->time, st);
+    linkstats(&sim->channels[B].link, sim->time, st);
+  }
+  for (i=0; i<sim->params.nflows; i++) {
+    fs = &sim->flows[i].stats;
+    if (sim->params.bandwidth > 0.0 && !sim->params.bottleneck) {
+      linkstats(&sim->flows[i].channels[A].link, sim->time, fs);
+      linkstats(&sim->flows[i].channels[B].link, sim->time, fs);
+    }
+    st->window_full += fs->window_full;
+    st->total_ACKs_received += fs->total_ACKs_received;
+    st->packets_sent += fs->packets_sent;
+    st->packets_resent += fs->packets_resent;
+    st->new_ACKs += fs->new_ACKs;
+    st->packets_received += fs->packets_received;
+    st->ACKs_sent += fs->ACKs_sent;
+    st->ACKs_piggybacked += fs->ACKs_piggybacked;
+    st->spurious_resends += fs->spurious_resends;
+    st->backlogged += fs->backlogged;
+    if (fs->backlog_peak > st->backlog_peak)
+      st->backlog_peak = fs->backlog_peak;
+    st->backlog_wait += fs->backlog_wait;
+    st->backlog_area += fs->backlog_area;
+    st->queue_drops += fs->queue_drops;
+    if (fs->queue_peak > st->queue_peak)
+      st->queue_peak = fs->queue_peak;
+    st->queue_wait += fs->queue_wait;
+    st->queue_area += fs->queue_area;
+    st->nsim += fs->nsim;
+    st->ntolayer3 += fs->ntolayer3;
+    st->nlost += fs->nlost;
+    st->ncorrupt += fs->ncorrupt;
+    st->nreordered += fs->nreordered;
+    st->nduplicated += fs->nduplicated;
+    st->messages_delivered += fs->messages_delivered;
+    st->bytes_delivered += fs->bytes_delivered;
+    metricsflowfinish(&sim->metrics, &sim->flows[i].metrics, fs);
+  }
+  metricsfinish(&sim->metrics, st);
+}
+
+/* run a simulation created by sim_create() to the end, on this thread.
+   -1 if the protocol can't run with its parameters, so it wasn't run */
+int sim_run(struct sim_context *sim)
 {
   struct event *eventptr;
-  struct msg  msg2give;
-  struct pkt  pkt2give;
+  struct msg *msg2give = sim->message;
+  struct idtimer *t;
+  struct sim_context *prevsim = cursim;
+  struct flow *f;
+  int prevtrace = TRACE;
    
-  int i,j;
+  int i,j,refused;
   
-  init();
-  A_init();
-  B_init();
+  cursim = sim;
+  TRACE = sim->params.trace;
+  for (f = sim->flows; f < sim->flows + sim->params.nflows; f++) {
+    sim->curflow = f;
+    generate_next_arrival(sim);     /* initialize event list */
+  }
+  for (f = sim->flows; f < sim->flows + sim->params.nflows; f++) {
+    sim->curflow = f;
+    if (sim->protocol->init(A) < 0 || sim->protocol->init(B) < 0) {
+      cursim = prevsim;
+      TRACE = prevtrace;
+      return -1;
+    }
+  }
    
   while (1) {
-    eventptr = evlist;            /* get next event to simulate */
+    eventptr = popevent(sim);        /* get next event to simulate */
     if (eventptr==NULL)
-      goto terminate;
-    evlist = evlist->next;        /* remove this event from event list */
-    if (evlist!=NULL)
-      evlist->prev=NULL;
-    if (TRACE>=2) {
+      break;
+    sim->curflow = f = &sim->flows[eventptr->evflow];
+    if (TRACING(1)) {
       printf("\nEVENT time: %f,",eventptr->evtime);
       printf("  type: %d",eventptr->evtype);
       if (eventptr->evtype==0)
         printf(", timerinterrupt  ");
       else if (eventptr->evtype==1)
         printf(", fromlayer5 ");
-      else
+      else if (eventptr->evtype==2)
         printf(", fromlayer3 ");
-      printf(" entity: %d\n",eventptr->eventity);
+      else if (eventptr->evtype==3)
+        printf(", timerinterrupt %d ", eventptr->evtimerid);
+      else
+        printf(", wheeltick ");
+      printf(" entity: %d",eventptr->eventity);
+      if (eventptr->evflow > 0)
+        printf(" flow: %d",eventptr->evflow);
+      printf("\n");
     }
-    time = eventptr->evtime;        /* update time to next event time */
+    sim->time = eventptr->evtime;        /* update time to next event time */
+    tracerecord(sim, TR_EVENT, eventptr->eventity,
+                eventptr->evtype == IDTIMER_INTERRUPT ? eventptr->evtimerid : 0,
+                0, eventptr->evtype, 0, 0);
+    if (eventptr->evtype != WHEEL_TICK) {
+      sim->stats.endtime = sim->time;
+      f->stats.endtime = sim->time;
+    }
+    sim->stats.nevents++;
     if (eventptr->evtype == FROM_LAYER5 ) {
-      if (nsim < nsimmax) {
-        generate_next_arrival();   /* set up future arrival */
+      if (f->stats.nsim < sim->params.nsimmax) {
+        generate_next_arrival(sim);   /* set up future arrival */
         /* fill in msg to give with string of same letter */    
-        j = nsim % 26; 
-        for (i=0; i<20; i++)  
-          msg2give.data[i] = 97 + j;
-        if (TRACE>2) {
+        j = f->stats.nsim % 26; 
+        msg2give->length = sim->params.msgsize;
+        memset(msg2give->data, 97 + j, msg2give->length);
+        if (TRACING(2)) {
           printf("          MAINLOOP: data given to student: ");
-          for (i=0; i<20; i++) 
-            printf("%c", msg2give.data[i]);
+          for (i=0; i<msg2give->length; i++) 
+            printf("%c", msg2give->data[i]);
           printf("\n");
         }
-        nsim++;
-        if (eventptr->eventity == A) 
-          A_output(msg2give);  
-        else
-          B_output(msg2give);  
+        tracerecord(sim, TR_MESSAGE, eventptr->eventity, 0, 0, 0,
+                    msg2give->length, msg2give->data[0]);
+        f->stats.nsim++;
+        refused = f->stats.window_full;
+        sim->protocol->output(eventptr->eventity, msg2give);
+        if (f->stats.window_full == refused)
+          metricsaccepted(&f->metrics, eventptr->eventity, sim->time);
       }
-      else if (TRACE > 2)
+      else {
+        if (TRACING(2))
           printf("          FROM_LAYER5: no more messages to send: \n");
+        tracerecord(sim, TR_NOMORE, eventptr->eventity, 0, 0, 0, 0, 0);
+      }
     }
     else if (eventptr->evtype ==  FROM_LAYER3) {
-      pkt2give.seqnum = eventptr->pktptr->seqnum;
-      pkt2give.acknum = eventptr->pktptr->acknum;
-      pkt2give.checksum = eventptr->pktptr->checksum;
-      for (i=0; i<20; i++)  
-        pkt2give.payload[i] = eventptr->pktptr->payload[i];
-	    if (eventptr->eventity ==A)      /* deliver packet by calling */
-        A_input(pkt2give);            /* appropriate entity */
-      else
-        B_input(pkt2give);
-	    free(eventptr->pktptr);          /* free the memory for packet */
+      medium(sim, f, eventptr->eventity)->inflight--;
+      metricsinflight(&sim->metrics, -1, sim->time);
+      /* the entity reads the packet in place; the event is only freed
+         once it returns */
+      sim->protocol->input(eventptr->eventity, eventptr->pkt);
     }
     else if (eventptr->evtype ==  TIMER_INTERRUPT) {
-      if (eventptr->eventity == A) 
-        A_timerinterrupt();
-      else
-        B_timerinterrupt();
+      f->timers[eventptr->eventity] = NULL;  /* handler may start it again */
+      sim->protocol->timerinterrupt(eventptr->eventity);
+    }
+    else if (eventptr->evtype ==  IDTIMER_INTERRUPT) {
+      t = findidtimer(sim, eventptr->eventity, eventptr->evtimerid, 0);
+      t->state = IDTIMER_OFF;       /* handler may start it again */
+      t->ev = NULL;
+      sim->protocol->idtimerinterrupt(eventptr->eventity, eventptr->evtimerid);
+    }
+    else if (eventptr->evtype ==  WHEEL_TICK) {
+      advancewheel(sim);
     }
     else  {
       printf("INTERNAL PANIC: unknown event type \n");
     }
-    free(eventptr);
+    freeevent(sim, eventptr);
   }
+  sumflows(sim);
 
- terminate:
-  printf(" Simulator terminated at time %f\n after attempting to send %d msgs from layer5\n",time,nsim);
-  printf("number of messages dropped due to full window:  %d \n", window_full);
-  printf("number of valid (not corrupt or duplicate) acknowledgements received at A:  %d \n", new_ACKs);
+  cursim = prevsim;
+  TRACE = prevtrace;
+  return 0;
+}
+
+/* bench.c builds the emulator with its own main() */
+#ifndef EMULATOR_NO_MAIN
+static void usage(void)
+{
+  fprintf(stderr, "usage: emulator [-option value] ...\n"
+          "       emulator -sweep ...\n"
+          "  options: -seed -tracefile -payload -msgsize -bidir -flows -bottleneck -rto\n"
+          "           -window -seqspace -backlog -cc -protocol -bandwidth -delay -queue -aqm\n"
+          "           -burst -burstend -burstloss -reorder -reorderdelay -reorderdir -dup -dupdir\n");
+}
+
+int main(int argc, char *argv[])
+{
+  struct sim_params params;
+  struct sim_context *sim;
+  const struct sim_stats *stats;
+  int i;
+
+  if (argc > 1 && strcmp(argv[1], "-sweep") == 0)
+    return sweep_main(argc-1, argv+1);
+
+  params.seed = 9999;
+  params.tracefile = NULL;
+  params.payloadsize = 20;
+  params.msgsize = 20;
+  params.bidirectional = 0;
+  params.nflows = 1;
+  params.bottleneck = 0;
+  params.adaptiverto = 0;
+  params.windowsize = 0;
+  params.seqspace = 0;
+  params.backlog = 0;
+  params.congestion = 0;
+  params.protocol = PROTO_GBN;
+  params.bandwidth = 0.0;
+  params.linkdelay = LINKDELAY;
+  params.queuelimit = 0;
+  params.aqm = QUEUE_DROPTAIL;
+  params.burstprob = 0.0;
+  params.burstend = 0.0;
+  params.burstloss = 1.0;
+  params.reorderprob = 0.0;
+  params.reorderdelay = REORDERDELAY;
+  params.reorderdirection = 2;
+  params.dupprob = 0.0;
+  params.dupdirection = 2;
+  for (i=1; i<argc; i+=2) {
+    if (i+1 == argc) {
+      fprintf(stderr, "emulator: %s needs a value\n", argv[i]);
+      usage();
+      exit(EXIT_FAILURE);
+    }
+    if (strcmp(argv[i], "-seed") == 0)
+      params.seed = strtoul(argv[i+1], NULL, 0);
+    else if (strcmp(argv[i], "-tracefile") == 0)
+      params.tracefile = argv[i+1];
+    else if (strcmp(argv[i], "-payload") == 0)
+      params.payloadsize = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-msgsize") == 0)
+      params.msgsize = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-bidir") == 0)
+      params.bidirectional = atoi(argv[i+1]) != 0;
+    else if (strcmp(argv[i], "-flows") == 0)
+      params.nflows = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-bottleneck") == 0)
+      params.bottleneck = atoi(argv[i+1]) != 0;
+    else if (strcmp(argv[i], "-rto") == 0)
+      params.adaptiverto = atoi(argv[i+1]) != 0;
+    else if (strcmp(argv[i], "-window") == 0)
+      params.windowsize = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-seqspace") == 0)
+      params.seqspace = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-backlog") == 0)
+      params.backlog = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-cc") == 0)
+      params.congestion = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-bandwidth") == 0)
+      params.bandwidth = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-delay") == 0)
+      params.linkdelay = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-queue") == 0)
+      params.queuelimit = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-aqm") == 0)
+      params.aqm = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-burst") == 0)
+      params.burstprob = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-burstend") == 0)
+      params.burstend = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-burstloss") == 0)
+      params.burstloss = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-reorder") == 0)
+      params.reorderprob = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-reorderdelay") == 0)
+      params.reorderdelay = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-reorderdir") == 0)
+      params.reorderdirection = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-dup") == 0)
+      params.dupprob = atof(argv[i+1]);
+    else if (strcmp(argv[i], "-dupdir") == 0)
+      params.dupdirection = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-protocol") == 0) {
+      params.protocol = findprotocol(argv[i+1]);
+      if (params.protocol < 0) {
+        fprintf(stderr, "emulator: unknown protocol %s\n", argv[i+1]);
+        usage();
+        exit(EXIT_FAILURE);
+      }
+    }
+    else {
+      fprintf(stderr, "emulator: unknown option %s\n", argv[i]);
+      usage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  init(&params);     /* after the options, so that a bad one is caught before any questions */
+  sim = sim_create(&params);
+  if (sim == NULL || sim_run(sim) < 0)
+    exit(EXIT_FAILURE);
+  stats = sim_getstats(sim);
+
+  printf(" Simulator terminated at time %f\n after attempting to send %d msgs from layer5\n",stats->endtime,stats->nsim);
+  printf("number of messages dropped due to full window:  %d \n", stats->window_full);
+  printf("number of valid (not corrupt or duplicate) acknowledgements received at A:  %d \n", stats->new_ACKs);
   printf("(note: a single acknowledgement may have acknowledged more than one packet - if cumulative acknowledgements are used)\n");
-  printf("number of packet resends by A:  %d \n", packets_resent);
-  printf("number of correct packets received at B:  %d \n", packets_received);
-  printf("number of messages delivered to application:  %d \n", messages_delivered);
+  printf("number of packet resends by A:  %d \n", stats->packets_resent);
+  printf("number of them found to be spurious:  %d \n", stats->spurious_resends);
+  printf("number of correct packets received at B:  %d \n", stats->packets_received);
+  printf("number of messages delivered to application:  %d \n", stats->messages_delivered);
+  printf("number of ACKs sent alone:  %d, piggybacked on data:  %d\n", stats->ACKs_sent, stats->ACKs_piggybacked);
+  printf("peak number of pending events:  %d (%d event slabs)\n", stats->evpeak, stats->nevslabs);
+  printf("message latency:  mean %f, p50 %f, p99 %f, p99.9 %f, max %f\n", stats->latency_mean,
+         stats->latency_p50, stats->latency_p99, stats->latency_p999, stats->latency_max);
+  printf("goodput:  %f messages (%f bytes) per time unit\n", stats->goodput, stats->goodput_bytes);
+  printf("retransmission ratio:  %f \n", stats->retransmit_ratio);
+  printf("packets in flight:  mean %f, peak %d\n", stats->inflight_mean, stats->inflight_peak);
+  if (params.backlog > 0)
+    printf("backlog:  %d messages waited, %f time units on average; waiting mean %f, peak %d\n",
+           stats->backlogged, stats->backlog_delay, stats->backlog_mean, stats->backlog_peak);
+  if (params.reorderprob > 0.0 || params.dupprob > 0.0)
+    printf("packets held back:  %d, duplicated:  %d\n", stats->nreordered, stats->nduplicated);
+  if (params.bandwidth > 0.0)
+    printf("router queues:  %d packets dropped, waiting mean %f, peak %d; queueing delay %f\n",
+           stats->queue_drops, stats->queue_mean, stats->queue_peak, stats->queue_delay);
+  if (params.nflows > 1) {
+    printf("flows:  %d%s, goodput per flow min %f, max %f, fairness %f\n", params.nflows,
+           params.bottleneck ? " sharing a bottleneck" : "", stats->flow_goodput_min,
+           stats->flow_goodput_max, stats->fairness);
+    for (i=0; i<params.nflows; i++) {
+      stats = sim_getflowstats(sim, i);
+      printf("flow %d:  %d messages delivered, goodput %f, %d resends, retransmission ratio %f, latency mean %f\n",
+             i, stats->messages_delivered, stats->goodput, stats->packets_resent,
+             stats->retransmit_ratio, stats->latency_mean);
+    }
+  }
+  sim_destroy(sim);
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+#endif
@@ -1,40 +1,222 @@
-extern int TRACE;
+#include <stddef.h>
 
-/* statistics updated by GBN */
-extern int total_ACKs_received;
-extern int packets_resent;       /* count of the number of packets resent  */
-extern int new_ACKs;      /* count of the number of acks correctly received */
-extern int packets_received;  /* count of the packets received by receiver */
-extern int window_full; /* count of the number of messages dropped due to full window */
+/* trace level of the simulation running on this thread */
+extern _Thread_local int TRACE;
+
+/* the highest trace level compiled in.  Trace output above it is dropped
+   at compile time together with its test of TRACE, so building with
+   -DTRACEMAX=0 leaves no tracing in the hot paths at all. */
+#ifndef TRACEMAX
+#define TRACEMAX 4
+#endif
+
+/* true when trace output of the given level is wanted, as TRACE > level */
+#define TRACING(level) ((level) < TRACEMAX && TRACE > (level))
 
 #define   A    0
 #define   B    1
 
 /* a "msg" is the data unit passed from layer 5 (teachers code) to layer  */
 /* 4 (students' code).  It contains the data (characters) to be delivered */
-/* to layer 5 via the students transport level protocol entities.         */
+/* to layer 5 via the students transport level protocol entities.  Every */
+/* message of a simulation has messagesize() bytes.                       */
 struct msg {
-  char data[20];
+  int length;
+  char data[];
 };
 
 /* a packet is the data unit passed from layer 4 (students code) to layer */
 /* 3 (teachers code).  Note the pre-defined packet structure, which all   */
-/* students must follow. */
+/* students must follow.  A packet carries between 0 and payloadsize()    */
+/* bytes, so a message bigger than that has to be sent in several; a      */
+/* buffer of pktsize() bytes holds any packet.                            */
 struct pkt {
   int seqnum;
   int acknum;
   int checksum;
-  char payload[20];
+  int length;             /* bytes of payload */
+  char payload[];
 };
 
-/* send to A or B (int), packet to send */
-extern void tolayer3(int, struct pkt);  
+/* send to A or B (int), packet to send.  The emulator copies it, so the
+   caller may reuse it once this returns */
+extern void tolayer3(int, const struct pkt *);
+
+/* deliver to A or B (int), data to deliver and its length */
+extern void tolayer5(int, const char[], int); 
+
+/* the payload and message sizes of the simulation, and the buffer size
+   of a packet */
+extern int payloadsize(void);
+extern int messagesize(void);
+extern size_t pktsize(void);
+
+/* 1 if B sends messages to A as well, 0 if only A sends */
+extern int bidirectional(void);
+
+/* the window size and sequence space of the protocols, or 0 if not
+   given, leaving them to the protocol */
+extern int windowsize(void);
+extern int seqspace(void);
+
+/* messages a sender may hold while its window is full, 0 if they are
+   dropped (see backlog.c) */
+extern int backlogsize(void);
 
-/* deliver to A or B (int), data to deliver */
-extern void tolayer5(int, char[20]); 
+/* the congestion control of the senders, a CC_ code of cc.h */
+extern int congestioncontrol(void);
+
+/* the congestion window of A or B (int) is now cwnd packets, and its
+   slow start threshold ssthresh (< 0 if there is none yet) */
+extern void reportcwnd(int, double, double);
+
+/* 1 if the medium may deliver a packet after packets sent later than
+   it, 0 if it keeps them in order */
+extern int reordering(void);
+
+/* 1 if senders time out after an estimate of the round trip time, 0 if
+   after a fixed time */
+extern int adaptiverto(void);
+
+/* the current simulation time */
+extern double simtime(void);
 
 /* start timer at A or B (int), increment */
 extern void starttimer(int, double);       
 
 /* stop timer at A or B (int) */
-extern void stoptimer(int);               
+extern void stoptimer(int);
+
+/* restart (or start) timer at A or B (int), increment from now */
+extern void restarttimer(int, double);
+
+/* start logical timer id (int) at A or B (int), increment */
+extern void startidtimer(int, int, double);
+
+/* stop logical timer id (int) at A or B (int) */
+extern void stopidtimer(int, int);
+
+/* is logical timer id (int) at A or B (int) running: 1 yes, 0 no */
+extern int idtimerrunning(int, int);               
+
+/* the most time a packet is held back, if reorderprob is set */
+#define REORDERDELAY 10.0
+
+/* parameters of a simulation, as asked for by init() (except the seed,
+   the trace file, the sizes, the direction and the flows) */
+struct sim_params {
+  int nsimmax;            /* number of msgs to generate (per flow), then stop */
+  float lossprob;         /* probability that a packet is dropped  */
+  float corruptprob;      /* probability that one bit is packet is flipped */
+  int corruptdirection;   /* A->B A<-B or bidirectional corruption/loss */
+  float lambda;           /* arrival rate of messages from layer 5 */
+  int trace;              /* TRACE while the simulation runs */
+  unsigned long seed;     /* seed of the random number generators */
+  const char *tracefile;  /* binary trace written here (see trace.h), or NULL */
+  int payloadsize;        /* bytes of payload a packet can carry */
+  int msgsize;            /* bytes in each message from layer 5 */
+  int bidirectional;      /* 0 = A->B  1 =  A<->B */
+  int nflows;             /* number of A,B pairs sharing the simulation */
+  int bottleneck;         /* 1 if the flows share one medium each way */
+  int adaptiverto;        /* 1 if retransmission timeouts follow the RTT */
+  int windowsize;         /* packets a sender may have unACKed, 0 for the protocol's own */
+  int seqspace;           /* sequence numbers used, 0 for the protocol's own */
+  int backlog;            /* messages a sender may hold while its window is full */
+  int congestion;         /* congestion control of the senders (see cc.h), 0 for none */
+  int protocol;           /* engine run by the entities, a PROTO_ code of protocol.h */
+  double bandwidth;       /* bytes per time unit a link carries, 0 for the unlimited medium */
+  double linkdelay;       /* time a packet takes along such a link once sent */
+  int queuelimit;         /* packets its router queue holds, 0 for no limit */
+  int aqm;                /* discipline of the router queue (see link.h) */
+  float burstprob;        /* probability the channel turns bad, 0 for independent losses */
+  float burstend;         /* probability it turns good again */
+  float burstloss;        /* loss probability while bad (lossprob while good) */
+  float reorderprob;      /* probability a packet is held back, letting others past */
+  double reorderdelay;    /* most time it is held back for */
+  int reorderdirection;   /* packets held back A->B A<-B or both */
+  float dupprob;          /* probability a packet arrives twice */
+  int dupdirection;       /* packets duplicated A->B A<-B or both */
+};
+
+/* statistics of a simulation, or of one of its flows.  The counters of
+   a simulation are the sums of those of its flows. */
+struct sim_stats {
+  /* updated by the protocol */
+  int window_full;        /* count of the number of messages dropped due to full window (and backlog) */
+  int total_ACKs_received;
+  int packets_sent;       /* data packets sent the first time */
+  int packets_resent;     /* count of the number of packets resent  */
+  int new_ACKs;           /* count of the number of acks correctly received */
+  int packets_received;   /* count of the packets received by receiver */
+  int ACKs_sent;          /* ACKs sent in packets of their own */
+  int ACKs_piggybacked;   /* ACKs sent on data packets instead */
+  int spurious_resends;   /* resends whose first copy was ACKed after all */
+  int backlogged;         /* messages that waited for room in the window */
+  int backlog_peak;       /* most messages waiting at one sender at a time */
+  double backlog_wait;    /* time they waited, in all */
+  double backlog_area;    /* integral of the messages waiting over time */
+
+  /* updated by the emulator */
+  int nsim;               /* number of messages from 5 to 4 */
+  int ntolayer3;          /* number sent into layer 3 */
+  int nlost;              /* number lost in media */
+  int ncorrupt;           /* number corrupted by media */
+  int nreordered;         /* number held back by media */
+  int nduplicated;        /* number duplicated by media */
+  int messages_delivered; /* number delivered to layer 5 */
+  long bytes_delivered;   /* bytes delivered to layer 5 */
+  int evpeak;             /* peak number of pending events */
+  int nevslabs;           /* number of event slabs allocated */
+  long nevents;           /* number of events simulated */
+  double endtime;         /* time of the last event (of the flow) */
+  int queue_drops;        /* packets dropped by a router queue, full or by its discipline */
+  int queue_peak;         /* most packets in one router queue at a time */
+  double queue_wait;      /* time packets waited in router queues, in all */
+  double queue_area;      /* integral of the packets in router queues over time */
+
+  /* end to end metrics, filled in at the end (see metrics.c) */
+  double latency_mean;    /* message latency from layer 5 to layer 5 */
+  double latency_p50;
+  double latency_p99;
+  double latency_p999;
+  double latency_max;
+  double goodput;         /* messages delivered per time unit */
+  double goodput_bytes;   /* bytes delivered per time unit */
+  double retransmit_ratio;  /* share of the sender's data packets that were resends */
+  double inflight_mean;   /* packets in the network, averaged over time */
+  int inflight_peak;
+  double backlog_mean;    /* messages waiting for the window, averaged over time */
+  double backlog_delay;   /* mean wait of the messages that waited */
+  double queue_mean;      /* packets in router queues, averaged over time */
+  double queue_delay;     /* mean wait of the packets sent on from a router queue */
+
+  /* how the flows shared the network (whole simulation only) */
+  double fairness;        /* Jain's index of the flows' goodput */
+  double flow_goodput_min;
+  double flow_goodput_max;
+};
+
+/* a simulation: its event queue, random numbers, channel, statistics and
+   protocol state.  Simulations are independent of each other; each one
+   must only be run by one thread at a time. */
+struct sim_context;
+
+/* create a simulation, run it to the end on this thread, read its
+   statistics, release it.  Parameters that are not valid are reported on
+   stderr: sim_create() returns NULL for them, and sim_run() -1 for those
+   the protocol turns down when it starts */
+extern struct sim_context *sim_create(const struct sim_params *);
+extern int sim_run(struct sim_context *);
+extern const struct sim_stats *sim_getstats(const struct sim_context *);
+extern void sim_destroy(struct sim_context *);
+
+/* statistics of flow 0 .. nflows-1 of a simulation that has been run.
+   Only the end to end metrics that need no histogram are filled in. */
+extern const struct sim_stats *sim_getflowstats(const struct sim_context *, int);
+
+/* statistics of the flow being run on this thread */
+extern struct sim_stats *protocolstats(void);
+
+/* protocol state (of the given size, zeroed at first use) of the flow
+   being run on this thread; every flow has its own */
+extern void *protocolstate(size_t);
\ No newline at end of file
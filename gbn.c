@@ -1,8 +1,15 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include "emulator.h"
+#include "protocol.h"
 #include "gbn.h"
+#include "checksum.h"
+#include "rto.h"
+#include "backlog.h"
+#include "cc.h"
+#include "segment.h"
 
 /* ******************************************************************
    Go Back N protocol.  Adapted from J.F.Kurose
@@ -14,262 +21,468 @@
    - packets can be corrupted (either the header or the data portion)
    or lost, according to user-defined probabilities
    - packets will be delivered in the order in which they were sent
-   (although some can be lost).
+   (although some can be lost), unless the medium is asked to hold
+   packets back or duplicate them
 
    Modifications: 
    - removed bidirectional GBN code and other code not used by prac. 
    - fixed C style to adhere to current programming style
    - added GBN implementation
+   - messages larger than a packet's payload are sent in several packets
+   and put back together by the receiver
+   - bidirectional transfer: both entities run a sender and a receiver,
+   data packets carry the receiver's latest ACK, and a receiver holds its
+   ACK back for a moment in the hope of sending it on data
+   - the timeout can follow an estimate of the round trip time instead
+   of being fixed (see rto.c), backing off while packets keep timing out
+   - the window size and sequence space are set when the simulation is,
+   so windows of thousands of packets can be tried
+   - the entry points are reached through a struct protocol (see
+   protocol.c) rather than global A_ and B_ routines, so this engine and
+   the others can be linked into one program
 **********************************************************************/
 
-#define RTT  16.0       /* round trip time.  MUST BE SET TO 16.0 when submitting assignment */
-#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet */
-#define SEQSPACE 7      /* the min sequence space for GBN must be at least windowsize + 1 */
+#define RTT  16.0       /* round trip time, the timeout unless adaptiverto().  MUST BE SET TO 16.0 when submitting assignment */
+#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet, unless windowsize() is given */
+#define REORDERSEQSPACE 65536  /* sequence space unless seqspace() is given, if the medium reorders */
 #define NOTINUSE (-1)   /* used to fill header fields that are not being used */
+#define ACKDELAY (RTT/8)  /* longest time an ACK waits for data to ride on */
+#define ACKTIMER 0      /* logical timer of the ACK waiting for data */
+
+/* the sender and receiver of one entity.  Unless the simulation is
+   bidirectional only A's sender and B's receiver are used. */
+struct gbn_entity {
+  /* sender */
+  int windowfirst, windowlast;        /* array indexes of the first/last packet awaiting ACK */
+  int windowcount;                    /* the number of packets currently awaiting an ACK */
+  int nextseqnum;                     /* the next sequence number to be used by the sender */
+  struct rto rto;                     /* the timeout and the round trip it follows */
+  double *senttime;                   /* when each packet in buffer was last sent */
+  bool *resent;                       /* which packets in buffer have been sent more than once */
+  int backoff;                        /* timeouts since a packet was last ACKed first time */
+  struct backlog backlog;             /* messages waiting for room in the window */
+  struct cc cc;                       /* the congestion window and how it changes */
+
+  /* receiver */
+  int expectedseqnum;                 /* the sequence number expected next by the receiver */
+  int ackseqnum;                      /* the sequence number for the next ACK sent on its own */
+  bool ackpending;                    /* packets have been received but not yet ACKed */
+  struct reassembly rcv;              /* the message being put back together */
+};
+
+/* the protocol keeps all of its state in the simulation (see
+   protocolstate()) rather than in globals */
+struct gbn_state {
+  int windowsize;                     /* the maximum number of buffered unacked packets */
+  int seqspace;                       /* sequence numbers run from 0 to seqspace-1 */
+  struct gbn_entity entity[2];        /* A and B */
+
+  /* followed by the window buffers of A and B, windowsize packets of
+     pktsize() bytes each for storing packets waiting for ACK, the
+     backlogs of A and B, the send times and then the resent flags of the
+     packets in the windows, and then the messages being put back
+     together at A and B */
+};
+
+/* the window size of the simulation, or GBN's own */
+static int window(void)
+{
+  return windowsize() > 0 ? windowsize() : WINDOWSIZE;
+}
 
-/* generic procedure to compute the checksum of a packet.  Used by both sender and receiver  
-   the simulator will overwrite part of your packet with 'z's.  It will not overwrite your 
-   original checksum.  This procedure must generate a different checksum to the original if
-   the packet is corrupted.
-*/
-int ComputeChecksum(struct pkt packet)
+/* bytes of storage for each entity's backlog */
+static size_t backlogbytes(void)
 {
-  int checksum = 0;
-  int i;
+  return backlogstorage(backlogsize(), messagesize());
+}
 
-  checksum = packet.seqnum;
-  checksum += packet.acknum;
-  for ( i=0; i<20; i++ ) 
-    checksum += (int)(packet.payload[i]);
+static struct gbn_state *gbnstate(void)
+{
+  return protocolstate(sizeof(struct gbn_state) +
+                       2*(window()*(pktsize() + sizeof(double) + sizeof(bool)) +
+                          backlogbytes() + messagesize()));
+}
 
-  return checksum;
+/* the packet in slot i of entity's window buffer */
+static struct pkt *buffer(struct gbn_state *s, int entity, int i)
+{
+  return (struct pkt *)((char *)(s + 1) + (entity*s->windowsize + i)*pktsize());
 }
 
-bool IsCorrupted(struct pkt packet)
+/* the message being put back together at entity */
+static char *rcvmessage(struct gbn_state *s, int entity)
 {
-  if (packet.checksum == ComputeChecksum(packet))
-    return (false);
-  else
-    return (true);
+  return (char *)(s + 1) + 2*s->windowsize*(pktsize() + sizeof(double) + sizeof(bool)) +
+         2*backlogbytes() + entity*messagesize();
 }
 
+/* how far sequence number to is after from, allowing for wrap around */
+static int seqoffset(const struct gbn_state *s, int from, int to)
+{
+  return (to - from + s->seqspace) % s->seqspace;
+}
 
-/********* Sender (A) variables and functions ************/
+/* the cumulative ACK of a receiver: the last packet it got in order */
+static int lastinorder(const struct gbn_state *s, const struct gbn_entity *e)
+{
+  return (e->expectedseqnum + s->seqspace - 1) % s->seqspace;
+}
 
-static struct pkt buffer[WINDOWSIZE];  /* array for storing packets waiting for ACK */
-static int windowfirst, windowlast;    /* array indexes of the first/last packet awaiting ACK */
-static int windowcount;                /* the number of packets currently awaiting an ACK */
-static int A_nextseqnum;               /* the next sequence number to be used by the sender */
+/* send a data packet of entity's sender.  In a bidirectional simulation
+   it carries the receiver's ACK, so no separate ACK is needed */
+static void senddata(struct gbn_state *s, int entity, struct pkt *packet)
+{
+  struct gbn_entity *e = &s->entity[entity];
+
+  if (bidirectional()) {
+    packet->acknum = lastinorder(s, e);
+    if (e->ackpending) {
+      e->ackpending = false;
+      stopidtimer(entity, ACKTIMER);
+      protocolstats()->ACKs_piggybacked++;
+    }
+  }
+  else
+    packet->acknum = NOTINUSE;
+  packet->checksum = ComputeChecksum(packet); 
+  tolayer3(entity, packet);
+}
 
-/* called from layer 5 (application layer), passed the message to be sent to other side */
-void A_output(struct msg message)
+/* send the cumulative ACK of entity's receiver in a packet of its own */
+static void sendack(struct gbn_state *s, int entity)
 {
+  struct gbn_entity *e = &s->entity[entity];
   struct pkt sendpkt;
-  int i;
-
-  /* if not blocked waiting on ACK */
-  if ( windowcount < WINDOWSIZE) {
-    if (TRACE > 1)
-      printf("----A: New message arrives, send window is not full, send new messge to layer3!\n");
-
-    /* create packet */
-    sendpkt.seqnum = A_nextseqnum;
-    sendpkt.acknum = NOTINUSE;
-    for ( i=0; i<20 ; i++ ) 
-      sendpkt.payload[i] = message.data[i];
-    sendpkt.checksum = ComputeChecksum(sendpkt); 
 
-    /* put packet in window buffer */
-    /* windowlast will always be 0 for alternating bit; but not for GoBackN */
-    windowlast = (windowlast + 1) % WINDOWSIZE; 
-    buffer[windowlast] = sendpkt;
-    windowcount++;
+  if (e->ackpending) {
+    e->ackpending = false;
+    stopidtimer(entity, ACKTIMER);
+  }
+  sendpkt.acknum = lastinorder(s, e);
 
-    /* send out packet */
-    if (TRACE > 0)
-      printf("Sending packet %d to layer 3\n", sendpkt.seqnum);
-    tolayer3 (A, sendpkt);
+  /* create packet */
+  sendpkt.seqnum = e->ackseqnum;
+  e->ackseqnum = (e->ackseqnum + 1) % 2;
+    
+  /* we don't have any data to send */
+  sendpkt.length = 0;
 
-    /* start timer if first packet in window */
-    if (windowcount == 1)
-      starttimer(A,RTT);
+  /* computer checksum */
+  sendpkt.checksum = ComputeChecksum(&sendpkt); 
 
-    /* get next sequence number, wrap back to 0 */
-    A_nextseqnum = (A_nextseqnum + 1) % SEQSPACE;  
-  }
-  /* if blocked,  window is full */
-  else {
-    if (TRACE > 0)
-      printf("----A: New message arrives, send window is full\n");
-    window_full++;
-  }
+  /* send out packet */
+  protocolstats()->ACKs_sent++;
+  tolayer3(entity, &sendpkt);
 }
 
+/********* Sender variables and functions ************/
 
-/* called from layer 3, when a packet arrives for layer 4 
-   In this practical this will always be an ACK as B never sends data.
-*/
-void A_input(struct pkt packet)
+/* true if a message of length bytes can be sent now: the window, as far
+   as congestion control allows, has room for all of its packets */
+static bool room(int entity, int length)
 {
-  int ackcount = 0;
-  int i;
-
-  /* if received ACK is not corrupted */ 
-  if (!IsCorrupted(packet)) {
-    if (TRACE > 0)
-      printf("----A: uncorrupted ACK %d is received\n",packet.acknum);
-    total_ACKs_received++;
-
-    /* check if new ACK or duplicate */
-    if (windowcount != 0) {
-          int seqfirst = buffer[windowfirst].seqnum;
-          int seqlast = buffer[windowlast].seqnum;
-          /* check case when seqnum has and hasn't wrapped */
-          if (((seqfirst <= seqlast) && (packet.acknum >= seqfirst && packet.acknum <= seqlast)) ||
-              ((seqfirst > seqlast) && (packet.acknum >= seqfirst || packet.acknum <= seqlast))) {
-
-            /* packet is a new ACK */
-            if (TRACE > 0)
-              printf("----A: ACK %d is not a duplicate\n",packet.acknum);
-            new_ACKs++;
-
-            /* cumulative acknowledgement - determine how many packets are ACKed */
-            if (packet.acknum >= seqfirst)
-              ackcount = packet.acknum + 1 - seqfirst;
-            else
-              ackcount = SEQSPACE - seqfirst + packet.acknum;
-
-	    /* slide window by the number of packets ACKed */
-            windowfirst = (windowfirst + ackcount) % WINDOWSIZE;
-
-            /* delete the acked packets from window buffer */
-            for (i=0; i<ackcount; i++)
-              windowcount--;
-
-	    /* start timer again if there are still more unacked packets in window */
-            stoptimer(A);
-            if (windowcount > 0)
-              starttimer(A, RTT);
+  struct gbn_state *s = gbnstate();
 
-          }
-        }
-        else
-          if (TRACE > 0)
-        printf ("----A: duplicate ACK received, do nothing!\n");
-  }
-  else 
-    if (TRACE > 0)
-      printf ("----A: corrupted ACK is received, do nothing!\n");
+  return ccroom(&s->entity[entity].cc, s->windowsize, s->entity[entity].windowcount,
+                segments(length));
 }
 
-/* called when A's timer goes off */
-void A_timerinterrupt(void)
+/* send message in the next packets of entity's window, which has room for it */
+static void sendmessage(int entity, const struct msg *message)
 {
+  struct gbn_state *s = gbnstate();
+  struct gbn_entity *e = &s->entity[entity];
+  struct pkt *sendpkt;
+  int nsegments = segments(message->length);
   int i;
 
-  if (TRACE > 0)
-    printf("----A: time out,resend packets!\n");
+  for (i=0; i<nsegments; i++) {
+    /* create packet for the next piece of the message, in place in the window buffer */
+    /* windowlast will always be 0 for alternating bit; but not for GoBackN */
+    e->windowlast = (e->windowlast + 1) % s->windowsize; 
+    sendpkt = buffer(s, entity, e->windowlast);
+    sendpkt->seqnum = e->nextseqnum;
+    segment(sendpkt, message, i);
+    e->senttime[e->windowlast] = simtime();
+    e->resent[e->windowlast] = false;
+    e->windowcount++;
 
-  for(i=0; i<windowcount; i++) {
+    /* send out packet */
+    if (TRACING(0))
+      printf("Sending packet %d to layer 3\n", sendpkt->seqnum);
+    senddata(s, entity, sendpkt);
+    protocolstats()->packets_sent++;
+    ccsent(&e->cc, e->windowcount);
 
-    if (TRACE > 0)
-      printf ("---A: resending packet %d\n", (buffer[(windowfirst+i) % WINDOWSIZE]).seqnum);
+    /* start timer if first packet in window */
+    if (e->windowcount == 1)
+      starttimer(entity, rtotimeout(&e->rto, e->backoff));
 
-    tolayer3(A,buffer[(windowfirst+i) % WINDOWSIZE]);
-    packets_resent++;
-    if (i==0) starttimer(A,RTT);
+    /* get next sequence number, wrap back to 0 */
+    e->nextseqnum = (e->nextseqnum + 1) % s->seqspace;  
   }
-}       
-
+}
 
+static const struct sender sender = { room, sendmessage };
 
-/* the following routine will be called once (only) before any other */
-/* entity A routines are called. You can use it to do any initialization */
-void A_init(void)
+/* called from layer 5 (application layer), passed the message to be sent
+   to other side.  It waits in the backlog if the window has no room */
+static void output(int entity, const struct msg *message)
 {
-  /* initialise A's window, buffer and sequence number */
-  A_nextseqnum = 0;  /* A starts with seq num 0, do not change this */
-  windowfirst = 0;
-  windowlast = -1;   /* windowlast is where the last packet sent is stored.  
-		     new packets are placed in winlast + 1 
-		     so initially this is set to -1
-		   */
-  windowcount = 0;
+  backlogoutput(&gbnstate()->entity[entity].backlog, &sender, entity, message);
 }
 
 
+/* called when an uncorrupted packet carrying ACK acknum arrives for entity's
+   sender.  pure if the packet carries no data, so that a repeat of the
+   last ACK is a duplicate ACK, sent for a packet out of order */
+static void ackinput(struct gbn_state *s, int entity, int acknum, bool pure)
+{
+  struct gbn_entity *e = &s->entity[entity];
+  int ackcount = 0;
+  int offset, i, slot;
+
+  if (TRACING(0))
+    printf("----%c: uncorrupted ACK %d is received\n", 'A'+entity, acknum);
+  protocolstats()->total_ACKs_received++;
+
+  /* check if new ACK or duplicate */
+  if (e->windowcount != 0) {
+        /* position of the ACKed packet in the window, if it is in there */
+        offset = seqoffset(s, buffer(s, entity, e->windowfirst)->seqnum, acknum);
+        if (offset < e->windowcount) {
+
+          /* packet is a new ACK */
+          if (TRACING(0))
+            printf("----%c: ACK %d is not a duplicate\n", 'A'+entity, acknum);
+          protocolstats()->new_ACKs++;
+
+          /* cumulative acknowledgement - determine how many packets are ACKed */
+          ackcount = offset + 1;
+
+          /* a resent packet ACKed too soon for the resend to have got
+             there was a spurious resend.  Only the last packet ACKed
+             times the round trip, and only if it was sent once */
+          for (i=0; i<ackcount; i++) {
+            slot = (e->windowfirst + i) % s->windowsize;
+            if (e->resent[slot] && rtospurious(&e->rto, simtime() - e->senttime[slot]))
+              protocolstats()->spurious_resends++;
+          }
+          slot = (e->windowfirst + ackcount - 1) % s->windowsize;
+          if (!e->resent[slot]) {
+            rtosample(&e->rto, simtime() - e->senttime[slot]);
+            e->backoff = 0;
+          }
+
+	  /* slide window by the number of packets ACKed */
+          e->windowfirst = (e->windowfirst + ackcount) % s->windowsize;
 
-/********* Receiver (B)  variables and procedures ************/
+          /* delete the acked packets from window buffer */
+          e->windowcount -= ackcount;
 
-static int expectedseqnum; /* the sequence number expected next by the receiver */
-static int B_nextseqnum;   /* the sequence number for the next packets sent by B */
+	  /* restart timer if there are still more unacked packets in window */
+          if (e->windowcount > 0)
+            restarttimer(entity, rtotimeout(&e->rto, e->backoff));
+          else
+            stoptimer(entity);
 
+          /* the window has moved on: congestion control may open it
+             further, and send what was waiting for the room made */
+          ccacked(&e->cc, ackcount, e->rto.srtt);
+          backlogdrain(&e->backlog, &sender, entity);
 
-/* called from layer 3, when a packet arrives for layer 4 at B*/
-void B_input(struct pkt packet)
+        }
+        else if (pure)
+          ccdupack(&e->cc);
+      }
+      else
+        if (TRACING(0))
+      printf ("----%c: duplicate ACK received, do nothing!\n", 'A'+entity);
+}
+
+/* called when the sender's timer goes off */
+static void timeout(int entity)
 {
-  struct pkt sendpkt;
-  int i;
+  struct gbn_state *s = gbnstate();
+  struct gbn_entity *e = &s->entity[entity];
+  int i, slot;
+
+  if (TRACING(0))
+    printf("----%c: time out,resend packets!\n", 'A'+entity);
+  e->backoff++;
+  cctimeout(&e->cc, e->windowcount, 0);
+
+  for(i=0; i<e->windowcount; i++) {
+    slot = (e->windowfirst+i) % s->windowsize;
+
+    if (TRACING(0))
+      printf ("---%c: resending packet %d\n", 'A'+entity,
+              buffer(s, entity, slot)->seqnum);
+
+    senddata(s, entity, buffer(s, entity, slot));
+    e->senttime[slot] = simtime();
+    e->resent[slot] = true;
+    protocolstats()->packets_resent++;
+    if (i==0) starttimer(entity, rtotimeout(&e->rto, e->backoff));
+  }
+}       
 
-  /* if not corrupted and received packet is in order */
-  if  ( (!IsCorrupted(packet))  && (packet.seqnum == expectedseqnum) ) {
-    if (TRACE > 0)
-      printf("----B: packet %d is correctly received, send ACK!\n",packet.seqnum);
-    packets_received++;
+/********* Receiver variables and procedures ************/
 
-    /* deliver to receiving application */
-    tolayer5(B, packet.payload);
 
-    /* send an ACK for the received packet */
-    sendpkt.acknum = expectedseqnum;
+/* called when an uncorrupted data packet arrives for entity's receiver */
+static void datainput(struct gbn_state *s, int entity, const struct pkt *packet)
+{
+  struct gbn_entity *e = &s->entity[entity];
+
+  /* if received packet is in order */
+  if  (packet->seqnum == e->expectedseqnum) {
+    if (TRACING(0))
+      printf("----%c: packet %d is correctly received, send ACK!\n", 'A'+entity, packet->seqnum);
+    protocolstats()->packets_received++;
+
+    /* deliver to receiving application */
+    reassemble(&e->rcv, entity, packet);
 
     /* update state variables */
-    expectedseqnum = (expectedseqnum + 1) % SEQSPACE;        
+    e->expectedseqnum = (e->expectedseqnum + 1) % s->seqspace;        
+
+    /* send an ACK for the received packet, unless it can wait for data
+       going the other way; later packets just move the waiting ACK on */
+    if (!bidirectional())
+      sendack(s, entity);
+    else if (!e->ackpending) {
+      e->ackpending = true;
+      startidtimer(entity, ACKTIMER, ACKDELAY);
+    }
   }
   else {
-    /* packet is corrupted or out of order resend last ACK */
-    if (TRACE > 0) 
-      printf("----B: packet corrupted or not expected sequence number, resend ACK!\n");
-    if (expectedseqnum == 0)
-      sendpkt.acknum = SEQSPACE - 1;
-    else
-      sendpkt.acknum = expectedseqnum - 1;
+    /* packet is out of order resend last ACK */
+    if (TRACING(0)) 
+      printf("----%c: packet corrupted or not expected sequence number, resend ACK!\n", 'A'+entity);
+    sendack(s, entity);
   }
+}
 
-  /* create packet */
-  sendpkt.seqnum = B_nextseqnum;
-  B_nextseqnum = (B_nextseqnum + 1) % 2;
-    
-  /* we don't have any data to send.  fill payload with 0's */
-  for ( i=0; i<20 ; i++ ) 
-    sendpkt.payload[i] = '0';  
+/* called from layer 3, when a packet arrives for layer 4 at entity.  It
+   carries an ACK for the sender, data for the receiver, or both */
+static void input(int entity, const struct pkt *packet)
+{
+  struct gbn_state *s = gbnstate();
+
+  if (IsCorrupted(packet)) {
+    /* a receiver that only gets data answers with its last ACK.  In a
+       bidirectional simulation the packet may have been an ACK, which is
+       better left to the sender's timeout than answered with another */
+    if (entity == B && !bidirectional()) {
+      if (TRACING(0)) 
+        printf("----B: packet corrupted or not expected sequence number, resend ACK!\n");
+      sendack(s, entity);
+    }
+    else if (TRACING(0))
+      printf ("----%c: corrupted packet is received, do nothing!\n", 'A'+entity);
+    return;
+  }
+  if (packet->acknum != NOTINUSE)
+    ackinput(s, entity, packet->acknum, packet->length == 0);
+  if (packet->length > 0)
+    datainput(s, entity, packet);
+}
 
-  /* computer checksum */
-  sendpkt.checksum = ComputeChecksum(sendpkt); 
+/* called when entity's ACK has waited ACKDELAY without data to ride on */
+static void acktimeout(int entity)
+{
+  struct gbn_state *s = gbnstate();
 
-  /* send out packet */
-  tolayer3 (B, sendpkt);
+  /* the timer has gone off, so it must not be stopped */
+  s->entity[entity].ackpending = false;
+  sendack(s, entity);
+}
+
+/* take the window size and sequence space of the simulation, or GBN's
+   own, with a sequence space of one more than the window unless one is
+   given.  The min sequence space for GBN must be at least windowsize + 1,
+   or the receiver can't tell a resent packet from a new one.
+   -1 if the window doesn't fit in the sequence space */
+static int windowinit(struct gbn_state *s)
+{
+  s->windowsize = window();
+
+  /* window+1 sequence numbers are enough if packets stay in order.  If
+     they don't, a packet held back may arrive after its number has come
+     round again and be taken for a later one, so the space is made so
+     large (as TCP's) that it doesn't come round that quickly */
+  if (seqspace() > 0)
+    s->seqspace = seqspace();
+  else if (reordering() && s->windowsize + 1 < REORDERSEQSPACE)
+    s->seqspace = REORDERSEQSPACE;
+  else
+    s->seqspace = s->windowsize + 1;
+  if (s->windowsize < 1 || s->seqspace < s->windowsize + 1) {
+    fprintf(stderr, "a window of %d packets needs a sequence space of at least %d, not %d.\n",
+            s->windowsize, s->windowsize + 1, s->seqspace);
+    return -1;
+  }
+  return 0;
 }
 
-/* the following routine will be called once (only) before any other */
-/* entity B routines are called. You can use it to do any initialization */
-void B_init(void)
+/* set up the sender and receiver of entity, -1 if the window is not valid */
+static int entityinit(int entity)
 {
-  expectedseqnum = 0;
-  B_nextseqnum = 1;
+  struct gbn_state *s = gbnstate();
+  struct gbn_entity *e = &s->entity[entity];
+  double *senttime;
+
+  if (s->windowsize == 0 && windowinit(s) < 0)
+    return -1;
+  backloginit(&e->backlog, (char *)(s + 1) + 2*s->windowsize*pktsize() + entity*backlogbytes(),
+              backlogsize(), messagesize());
+  senttime = (double *)((char *)(s + 1) + 2*s->windowsize*pktsize() + 2*backlogbytes());
+  e->senttime = senttime + entity*s->windowsize;
+  e->resent = (bool *)(senttime + 2*s->windowsize) + entity*s->windowsize;
+
+  /* initialise the window, buffer and sequence number */
+  e->nextseqnum = 0;  /* A starts with seq num 0, do not change this */
+  e->windowfirst = 0;
+  e->windowlast = -1;   /* windowlast is where the last packet sent is stored.  
+		     new packets are placed in winlast + 1 
+		     so initially this is set to -1
+		   */
+  e->windowcount = 0;
+  rtoinit(&e->rto, adaptiverto(), RTT);
+  ccinit(&e->cc, congestioncontrol(), entity);
+  e->backoff = 0;
+
+  e->expectedseqnum = 0;
+  e->ackseqnum = 1;
+  e->ackpending = false;
+  reassemblyinit(&e->rcv, rcvmessage(s, entity));
+  return 0;
 }
 
-/******************************************************************************
- * The following functions need be completed only for bi-directional messages *
- *****************************************************************************/
+/********* Entry points called by the emulator ************/
 
-/* Note that with simplex transfer from a-to-B, there is no B_output() */
-void B_output(struct msg message)  
+/* called once (only) for each entity before any of its other routines.
+   -1 if the window is not valid or too small for a message */
+static int gbninit(int entity)
 {
+  if (entityinit(entity) < 0)
+    return -1;
+  if (entity == A && segments(messagesize()) > gbnstate()->windowsize) {
+    fprintf(stderr, "a message needs %d packets but the window holds only %d.\n",
+            segments(messagesize()), gbnstate()->windowsize);
+    return -1;
+  }
+  return 0;
 }
 
-/* called when B's timer goes off */
-void B_timerinterrupt(void)
+/* the only logical timer is ACKTIMER */
+static void gbnidtimerinterrupt(int entity, int timerid)
 {
+  acktimeout(entity);
 }
 
+/* the entity's timer is the retransmission timer */
+const struct protocol gbnprotocol = {
+  "gbn", gbninit, output, input, timeout, gbnidtimerinterrupt
+};
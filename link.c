@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "link.h"
+
+/* ******************************************************************
+   Links of limited bandwidth.
+
+   Instead of arriving 1 to 10 time units after the packet ahead of it,
+   a packet sent on such a link waits in the router queue in front of it
+   until the transmitter is free, takes size/bandwidth to be sent and
+   delay more to get to the other end.  A burst of packets so shows up as
+   a queue that builds, and a queue that is full drops the packets that
+   arrive (drop-tail).  Two disciplines drop packets before that:
+
+   - RED (Floyd and Jacobson): an average of the queue length is kept,
+   and between a quarter and three quarters of the limit packets are
+   dropped at random, the more likely the longer the average is.  Above
+   three quarters every packet is.
+   - CoDel (RFC 8289): once packets have waited more than a target delay
+   for a whole interval, a packet leaving the queue is dropped, and then
+   more of them at intervals getting shorter as the square root of the
+   drops, until the wait falls below target again.
+
+   The queue is first in first out and the transmitter's rate is fixed,
+   so when a packet will leave the queue is known as soon as it arrives.
+   CoDel's verdict is therefore taken at arrival for the time the packet
+   leaves; a packet it drops keeps its place in the queue until then but
+   takes no time to send.  The queue's length when the packet leaves
+   isn't known yet, so CoDel doesn't spare the last packet of a queue.
+**********************************************************************/
+
+#define INITCAPACITY 16       /* departures held at first when the queue has no limit */
+#define REDWEIGHT 0.002       /* weight of the current length in RED's average */
+#define REDMAXP 0.1           /* RED's drop probability at the upper threshold */
+#define CODELTARGET 1.0       /* queueing delay CoDel allows */
+#define CODELINTERVAL 20.0    /* for this long, about a round trip */
+
+bool linkvalid(double bandwidth, double delay, int limit, int discipline)
+{
+  return bandwidth > 0.0 && delay >= 0.0 && limit >= 0 &&
+         discipline >= 0 && discipline < NQUEUES && (discipline != QUEUE_RED || limit >= 4);
+}
+
+int linkinit(struct link *l, double bandwidth, double delay, int limit, int discipline)
+{
+  if (!linkvalid(bandwidth, delay, limit, discipline))
+    return -1;
+  memset(l, 0, sizeof(struct link));
+  l->bandwidth = bandwidth;
+  l->delay = delay;
+  l->limit = limit;
+  l->discipline = discipline;
+  l->capacity = limit > 0 ? limit : INITCAPACITY;
+  l->departures = malloc(l->capacity * sizeof(double));
+  if (l->departures == 0) {
+    printf("memory allocation for link queue failed.");
+    exit(EXIT_FAILURE);
+  }
+  l->sinceearly = -1;
+  return 0;
+}
+
+/* take the packets that have left the queue by time off it */
+static void linkdrain(struct link *l, double time)
+{
+  double departure;
+
+  while (l->count > 0 && (departure = l->departures[l->head]) <= time) {
+    l->area += l->count * (departure - l->lastchange);
+    l->lastchange = departure;
+    l->head = (l->head + 1) % l->capacity;
+    if (--l->count == 0)
+      l->idlesince = departure;
+  }
+}
+
+/* add a packet arriving at time and leaving at departure to the queue */
+static void linkadd(struct link *l, double time, double departure)
+{
+  double *departures;
+  int i;
+
+  if (l->count == l->capacity) {      /* only if there is no limit */
+    departures = malloc(2 * l->capacity * sizeof(double));
+    if (departures == 0) {
+      printf("memory allocation for link queue failed.");
+      exit(EXIT_FAILURE);
+    }
+    for (i=0; i<l->count; i++)
+      departures[i] = l->departures[(l->head + i) % l->capacity];
+    free(l->departures);
+    l->departures = departures;
+    l->head = 0;
+    l->capacity *= 2;
+  }
+  l->area += l->count * (time - l->lastchange);
+  l->lastchange = time;
+  l->departures[(l->head + l->count) % l->capacity] = departure;
+  if (++l->count > l->peak)
+    l->peak = l->count;
+}
+
+/* RED's verdict on a packet arriving at time, that takes txtime to send:
+   true to drop it early */
+static bool redearly(struct link *l, double time, double txtime, double random)
+{
+  double minth = l->limit / 4.0, maxth = 3 * l->limit / 4.0;
+  double pb, pa;
+
+  /* an empty queue counts as the packets that could have been sent
+     while it was empty finding it so */
+  if (l->count > 0)
+    l->avg += REDWEIGHT * (l->count - l->avg);
+  else
+    l->avg *= pow(1 - REDWEIGHT, (time - l->idlesince) / txtime);
+
+  if (l->avg < minth) {
+    l->sinceearly = -1;
+    return false;
+  }
+  if (l->avg >= maxth) {
+    l->sinceearly = 0;
+    return true;
+  }
+  /* drops spread out evenly, rather than in clusters */
+  l->sinceearly++;
+  pb = REDMAXP * (l->avg - minth) / (maxth - minth);
+  pa = l->sinceearly * pb < 1.0 ? pb / (1.0 - l->sinceearly * pb) : 1.0;
+  if (random < pa) {
+    l->sinceearly = 0;
+    return true;
+  }
+  return false;
+}
+
+/* CoDel's verdict on a packet leaving the queue at time after waiting
+   sojourn: true to drop it rather than send it */
+static bool codeldrop(struct link *l, double time, double sojourn)
+{
+  bool above;
+
+  /* has the wait been above target for a whole interval? */
+  if (sojourn < CODELTARGET) {
+    l->firstabove = 0.0;
+    above = false;
+  }
+  else if (l->firstabove == 0.0) {
+    l->firstabove = time + CODELINTERVAL;
+    above = false;
+  }
+  else
+    above = time >= l->firstabove;
+
+  if (l->dropping) {
+    if (!above)
+      l->dropping = false;
+    else if (time >= l->dropnext) {
+      l->drops++;
+      l->dropnext += CODELINTERVAL / sqrt(l->drops);
+      return true;
+    }
+    return false;
+  }
+  if (!above)
+    return false;
+
+  /* start dropping, where it left off if it stopped only a little while ago */
+  l->dropping = true;
+  if (l->drops - l->lastdrops > 1 && time - l->dropnext < 16 * CODELINTERVAL)
+    l->drops = l->drops - l->lastdrops;
+  else
+    l->drops = 1;
+  l->lastdrops = l->drops;
+  l->dropnext = time + CODELINTERVAL / sqrt(l->drops);
+  return true;
+}
+
+double linksend(struct link *l, double time, int size, double random, double *wait)
+{
+  double txtime = size / l->bandwidth, start;
+
+  linkdrain(l, time);
+  if (l->discipline == QUEUE_RED && redearly(l, time, txtime, random))
+    return -1.0;
+  if (l->limit > 0 && l->count >= l->limit)
+    return -1.0;
+
+  start = l->busyuntil > time ? l->busyuntil : time;
+  *wait = start - time;
+  if (l->discipline == QUEUE_CODEL && codeldrop(l, start, *wait)) {
+    linkadd(l, time, start);
+    return -1.0;
+  }
+  l->busyuntil = start + txtime;
+  linkadd(l, time, l->busyuntil);
+  return l->busyuntil + l->delay;
+}
+
+void linkfinish(struct link *l, double time)
+{
+  linkdrain(l, time);
+  if (time > l->lastchange) {
+    l->area += l->count * (time - l->lastchange);
+    l->lastchange = time;
+  }
+}
+
+void linkfree(struct link *l)
+{
+  free(l->departures);
+  l->departures = NULL;
+}
@@ -0,0 +1,63 @@
+#include <stdbool.h>
+
+/* links of limited bandwidth with a router queue in front, see link.c */
+
+/* queue disciplines, as chosen by sim_params */
+#define QUEUE_DROPTAIL 0  /* drop arrivals only when the queue is full */
+#define QUEUE_RED      1  /* random early detection */
+#define QUEUE_CODEL    2  /* controlled delay */
+#define NQUEUES        3
+
+/* the delay of a link unless one is given, about the mean of the 1 to
+   10 units packets take on the unlimited medium */
+#define LINKDELAY 5.0
+
+/* one direction of a link: a transmitter sending bandwidth bytes per
+   time unit, packets taking delay more to get to the other end, and the
+   queue of packets waiting for it */
+struct link {
+  double bandwidth;
+  double delay;
+  int limit;              /* packets the queue holds (counting the one
+                             being sent), 0 for no limit */
+  int discipline;         /* QUEUE_ code */
+
+  /* when each packet in the queue leaves it, oldest first, in a ring */
+  double *departures;
+  int head, count, capacity;
+  double busyuntil;       /* when the transmitter is done with the queue */
+
+  /* occupancy */
+  double lastchange;      /* time count last changed */
+  double area;            /* integral of count over time */
+  int peak;
+
+  /* RED */
+  double avg;             /* average queue length */
+  double idlesince;       /* time the queue last went empty */
+  int sinceearly;         /* packets since the last early drop, or -1 */
+
+  /* CoDel */
+  double firstabove;      /* time the delay will have been above target
+                             for an interval, or 0 */
+  double dropnext;        /* time of the next drop while dropping */
+  bool dropping;
+  int drops, lastdrops;   /* drops in this dropping state and the last */
+};
+
+/* true if a link can have these parameters.  RED needs a limit of at
+   least 4 packets to set its thresholds from */
+extern bool linkvalid(double bandwidth, double delay, int limit, int discipline);
+
+/* set up l, -1 if the parameters are not valid */
+extern int linkinit(struct link *l, double bandwidth, double delay, int limit, int discipline);
+
+/* a packet of size bytes reaches l at time.  Returns the time it gets to
+   the other end, with its wait in the queue in wait, or < 0 if the queue
+   drops it.  random is uniform on [0,1), for RED. */
+extern double linksend(struct link *l, double time, int size, double random, double *wait);
+
+/* count the occupancy of l up to time, the end of the simulation */
+extern void linkfinish(struct link *l, double time);
+
+extern void linkfree(struct link *l);
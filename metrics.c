@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "emulator.h"
+#include "metrics.h"
+
+/* ******************************************************************
+   End to end metrics.
+
+   The emulator notes the time every message accepted by the sender was
+   given to it, and takes the oldest one off again when the other side
+   delivers a message to layer 5; both protocols deliver in order, so
+   that is the same message.  The difference goes into a log-bucketed
+   histogram, which gives the latency percentiles at the end of the run
+   in constant memory.  The number of packets in the network is
+   integrated over time for its mean.
+
+   A simulation of several flows keeps the messages on their way, and
+   the sum of their latencies, for every flow, and one histogram for the
+   lot.  How evenly the flows shared the network is given by Jain's
+   index of their goodput, (sum x)^2 / (n sum x^2), which is 1 when all
+   flows got the same and 1/n when one flow got everything.  A flow's
+   goodput is taken up to its own last event, so a flow that is held back
+   and finishes late counts as having got less.
+**********************************************************************/
+
+/* bucket holding value v.  The first 2^HISTSUBBITS buckets hold one value
+   each; after that every HISTHALF buckets cover twice the range of the
+   ones before. */
+static int histbucket(uint64_t v)
+{
+  int shift;
+
+  if (v < (1 << HISTSUBBITS))
+    return (int)v;
+  shift = 63 - __builtin_clzll(v) - HISTSUBBITS + 1;
+  return (1 << HISTSUBBITS) + (shift-1)*HISTHALF + (int)(v >> shift) - HISTHALF;
+}
+
+/* the middle of the values held by bucket i */
+static double histmiddle(int i)
+{
+  int shift, j;
+
+  if (i < (1 << HISTSUBBITS))
+    return i;
+  j = i - (1 << HISTSUBBITS);
+  shift = j/HISTHALF + 1;
+  return ldexp(j%HISTHALF + HISTHALF, shift) + ldexp(0.5, shift);
+}
+
+void histrecord(struct histogram *h, double value)
+{
+  double v = value * HISTUNIT;
+
+  h->total++;
+  h->sum += value;
+  if (value > h->max)
+    h->max = value;
+  if (v < 0.0)
+    v = 0.0;
+  else if (v >= 0x1.0p63)
+    v = 0x1.0p63;
+  h->counts[histbucket((uint64_t)v)]++;
+}
+
+/* the value below which a fraction q of the recorded values fall, 0 if
+   nothing was recorded */
+double histpercentile(const struct histogram *h, double q)
+{
+  uint64_t rank, seen = 0;
+  int i;
+
+  if (h->total == 0)
+    return 0.0;
+  rank = (uint64_t)ceil(q * h->total);
+  if (rank < 1)
+    rank = 1;
+  for (i=0; i<HISTBUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank)
+      break;
+  }
+  if (i == HISTBUCKETS)
+    i--;
+  /* the bucket's middle, but never above the largest value seen */
+  return fmin(histmiddle(i) / HISTUNIT, h->max);
+}
+
+/* the message accepted by entity AorB of a flow at time is on its way */
+void metricsaccepted(struct flowmetrics *f, int AorB, double time)
+{
+  struct msgqueue *q = &f->queued[AorB];
+  double *sent;
+  int i;
+
+  if (q->count == q->capacity) {
+    sent = malloc((q->capacity ? 2*q->capacity : 64) * sizeof(double));
+    if (sent == 0) {
+      printf("memory allocation for metrics failed.");
+      exit(EXIT_FAILURE);
+    }
+    for (i=0; i<q->count; i++)
+      sent[i] = q->sent[(q->head + i) % q->capacity];
+    free(q->sent);
+    q->sent = sent;
+    q->head = 0;
+    q->capacity = q->capacity ? 2*q->capacity : 64;
+  }
+  q->sent[(q->head + q->count) % q->capacity] = time;
+  q->count++;
+}
+
+/* entity AorB of a flow delivered a message to layer 5 at time */
+void metricsdelivered(struct metrics *m, struct flowmetrics *f, int AorB, double time)
+{
+  struct msgqueue *q = &f->queued[(AorB+1) % 2];
+
+  if (q->count == 0)
+    return;           /* more deliveries than messages: a protocol bug */
+  histrecord(&m->latency, time - q->sent[q->head]);
+  f->latencysum += time - q->sent[q->head];
+  q->head = (q->head + 1) % q->capacity;
+  q->count--;
+}
+
+/* change packets entered (or, negative, left) the network at time */
+void metricsinflight(struct metrics *m, int change, double time)
+{
+  m->inflightarea += m->inflight * (time - m->lastchange);
+  m->lastchange = time;
+  m->inflight += change;
+  if (m->inflight > m->inflightpeak)
+    m->inflightpeak = m->inflight;
+}
+
+/* goodput, retransmission ratio and backlog from the counters in stats */
+static void ratios(struct sim_stats *stats)
+{
+  int sent = stats->packets_sent + stats->packets_resent;
+  int forwarded = stats->ntolayer3 - stats->nlost - stats->queue_drops;
+
+  stats->goodput = stats->endtime > 0.0 ? stats->messages_delivered / stats->endtime : 0.0;
+  stats->goodput_bytes = stats->endtime > 0.0 ? stats->bytes_delivered / stats->endtime : 0.0;
+  stats->retransmit_ratio = sent > 0 ? (double)stats->packets_resent / sent : 0.0;
+  stats->backlog_mean = stats->endtime > 0.0 ? stats->backlog_area / stats->endtime : 0.0;
+  stats->backlog_delay = stats->backlogged ? stats->backlog_wait / stats->backlogged : 0.0;
+  stats->queue_mean = stats->endtime > 0.0 ? stats->queue_area / stats->endtime : 0.0;
+  stats->queue_delay = forwarded > 0 ? stats->queue_wait / forwarded : 0.0;
+}
+
+/* fill in the metrics of a flow that its stats (with endtime set) can
+   hold, and count its goodput towards the fairness of the simulation */
+void metricsflowfinish(struct metrics *m, struct flowmetrics *f, struct sim_stats *stats)
+{
+  stats->latency_mean = stats->messages_delivered ?
+    f->latencysum / stats->messages_delivered : 0.0;
+  ratios(stats);
+
+  if (m->nflows == 0 || stats->goodput < m->goodputmin)
+    m->goodputmin = stats->goodput;
+  if (m->nflows == 0 || stats->goodput > m->goodputmax)
+    m->goodputmax = stats->goodput;
+  m->goodputsum += stats->goodput;
+  m->goodputsumsq += stats->goodput * stats->goodput;
+  m->nflows++;
+}
+
+/* fill in the metrics part of stats at the end of a simulation, once
+   every flow is finished */
+void metricsfinish(struct metrics *m, struct sim_stats *stats)
+{
+  const struct histogram *h = &m->latency;
+
+  metricsinflight(m, 0, stats->endtime);
+  stats->latency_mean = h->total ? h->sum / h->total : 0.0;
+  stats->latency_p50 = histpercentile(h, 0.50);
+  stats->latency_p99 = histpercentile(h, 0.99);
+  stats->latency_p999 = histpercentile(h, 0.999);
+  stats->latency_max = h->max;
+  ratios(stats);
+  stats->inflight_mean = stats->endtime > 0.0 ? m->inflightarea / stats->endtime : 0.0;
+  stats->inflight_peak = m->inflightpeak;
+
+  stats->flow_goodput_min = m->goodputmin;
+  stats->flow_goodput_max = m->goodputmax;
+  stats->fairness = m->goodputsumsq > 0.0 ?
+    m->goodputsum * m->goodputsum / (m->nflows * m->goodputsumsq) : 1.0;
+}
+
+void metricsflowfree(struct flowmetrics *f)
+{
+  free(f->queued[A].sent);
+  free(f->queued[B].sent);
+  f->queued[A].sent = f->queued[B].sent = NULL;
+}
@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+/* end to end metrics of a simulation: message latency from layer 5 at the
+   sender to layer 5 at the receiver, and the number of packets in the
+   network over time, for the whole simulation and for each of its flows.
+   See metrics.c. */
+
+/* latency histogram.  Values are counted in units of 1/HISTUNIT time
+   units, in buckets whose width doubles every 2^(HISTSUBBITS-1) buckets,
+   so any value is known to within 1 part in 2^(HISTSUBBITS-1) whatever
+   its size, in a fixed amount of memory. */
+#define HISTSUBBITS 8
+#define HISTHALF (1 << (HISTSUBBITS-1))
+#define HISTBUCKETS ((1 << HISTSUBBITS) + (64 - HISTSUBBITS) * HISTHALF)
+#define HISTUNIT 1000.0
+
+struct histogram {
+  uint64_t total;         /* number of values recorded */
+  double sum;             /* their sum, for the mean */
+  double max;             /* the largest of them */
+  uint64_t counts[HISTBUCKETS];
+};
+
+/* send times of the messages on their way from one entity to the other,
+   oldest first, in a ring of capacity entries */
+struct msgqueue {
+  double *sent;
+  int head, count, capacity;
+};
+
+/* the messages of one flow */
+struct flowmetrics {
+  struct msgqueue queued[2];  /* messages accepted by A and by B */
+  double latencysum;          /* latency of the messages delivered */
+};
+
+struct metrics {
+  struct histogram latency;   /* of the messages of every flow */
+  int inflight;               /* packets in the network */
+  int inflightpeak;
+  double inflightarea;        /* integral of inflight over time */
+  double lastchange;          /* time inflight last changed */
+
+  /* goodput of the flows finished so far */
+  int nflows;
+  double goodputsum, goodputsumsq;
+  double goodputmin, goodputmax;
+};
+
+struct sim_stats;
+
+extern void histrecord(struct histogram *h, double value);
+extern double histpercentile(const struct histogram *h, double q);
+
+extern void metricsaccepted(struct flowmetrics *f, int AorB, double time);
+extern void metricsdelivered(struct metrics *m, struct flowmetrics *f, int AorB, double time);
+extern void metricsinflight(struct metrics *m, int change, double time);
+extern void metricsflowfinish(struct metrics *m, struct flowmetrics *f, struct sim_stats *stats);
+extern void metricsfinish(struct metrics *m, struct sim_stats *stats);
+extern void metricsflowfree(struct flowmetrics *f);
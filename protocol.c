@@ -0,0 +1,31 @@
+#include <string.h>
+#include "emulator.h"
+#include "protocol.h"
+#include "gbn.h"
+#include "sr.h"
+
+/* ******************************************************************
+   Protocol engines.
+
+   Each engine keeps its entry points to itself and makes them known
+   through a struct protocol (see protocol.h), so any number of engines
+   can be linked into one program.  The table below registers them side
+   by side; a simulation is created with the PROTO_ code of the one its
+   flows run, so the same program can compare them under the same seeds.
+   A new engine gets the next PROTO_ code and an entry at the end.
+**********************************************************************/
+
+const struct protocol *const protocols[NPROTOCOLS] = {
+  &gbnprotocol,
+  &srprotocol,
+};
+
+int findprotocol(const char *name)
+{
+  int i;
+
+  for (i=0; i<NPROTOCOLS; i++)
+    if (strcmp(protocols[i]->name, name) == 0)
+      return i;
+  return -1;
+}
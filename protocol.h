@@ -0,0 +1,26 @@
+/* protocol engines, see protocol.c.  Every flow of a simulation runs the
+   engine the simulation was created with, at both of its entities. */
+
+/* engines, as chosen by sim_params */
+#define PROTO_GBN 0       /* Go Back N, see gbn.c */
+#define PROTO_SR  1       /* Selective Repeat, see sr.c */
+#define NPROTOCOLS 2
+
+/* the entry points of an engine.  Each is called with the entity (A or
+   B) it is for; the emulator passes pointers to its own copy of the
+   packet or message, which are only valid until the call returns. */
+struct protocol {
+  const char *name;
+  int (*init)(int);                         /* once, before any other entry point; -1 if
+                                               the simulation's parameters don't suit it */
+  void (*output)(int, const struct msg *);  /* at B only if bidirectional() */
+  void (*input)(int, const struct pkt *);
+  void (*timerinterrupt)(int);
+  void (*idtimerinterrupt)(int, int);       /* with the logical timer id */
+};
+
+/* the engines by PROTO_ code */
+extern const struct protocol *const protocols[NPROTOCOLS];
+
+/* the PROTO_ code of the engine called name, -1 if there is none */
+extern int findprotocol(const char *name);
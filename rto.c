@@ -0,0 +1,68 @@
+#include "rto.h"
+
+/* ******************************************************************
+   Retransmission timeouts.
+
+   The round trip time is estimated as in RFC 6298: a smoothed mean SRTT
+   and mean deviation RTTVAR, updated with gains of 1/8 and 1/4, give a
+   timeout of SRTT + 4*RTTVAR.  By Karn's rule only packets sent once are
+   measured, since the ACK of a resent packet could be for any copy of
+   it, and each time a packet times out its next timeout is doubled
+   until it gets through.
+
+   The smallest round trip seen also tells when a resend was spurious:
+   an ACK that comes back sooner than that after the resend was set off
+   by an earlier copy, which wasn't lost after all.
+**********************************************************************/
+
+#define RTOMIN 1.0        /* smallest timeout, in time units */
+#define MAXBACKOFF 6      /* a timeout is backed off to at most 64 times its value */
+
+void rtoinit(struct rto *r, bool adaptive, double initial)
+{
+  r->adaptive = adaptive;
+  r->initial = initial;
+  r->srtt = 0.0;
+  r->rttvar = 0.0;
+  r->rttmin = 0.0;
+  r->timeout = initial;
+  r->samples = 0;
+}
+
+void rtosample(struct rto *r, double rtt)
+{
+  double err;
+
+  if (r->samples == 0) {
+    r->srtt = rtt;
+    r->rttvar = rtt / 2;
+    r->rttmin = rtt;
+  }
+  else {
+    err = rtt - r->srtt;
+    r->rttvar += ((err < 0 ? -err : err) - r->rttvar) / 4;
+    r->srtt += err / 8;
+    if (rtt < r->rttmin)
+      r->rttmin = rtt;
+  }
+  r->samples++;
+  if (r->adaptive) {
+    r->timeout = r->srtt + 4*r->rttvar;
+    if (r->timeout < RTOMIN)
+      r->timeout = RTOMIN;
+  }
+}
+
+double rtotimeout(const struct rto *r, int backoff)
+{
+  if (!r->adaptive)
+    return r->initial;
+  if (backoff > MAXBACKOFF)
+    backoff = MAXBACKOFF;
+  return r->timeout * (1 << backoff);
+}
+
+bool rtospurious(const struct rto *r, double elapsed)
+{
+  return r->samples > 0 && elapsed < r->rttmin;
+}
@@ -0,0 +1,27 @@
+#include <stdbool.h>
+
+/* retransmission timeouts for the protocols, see rto.c */
+
+/* what a sender knows of the round trip time to the other entity */
+struct rto {
+  bool adaptive;          /* timeout follows the RTT, or is always initial */
+  double initial;         /* timeout before the first sample, and the fixed one */
+  double srtt;            /* smoothed round trip time */
+  double rttvar;          /* its mean deviation */
+  double rttmin;          /* smallest round trip seen */
+  double timeout;         /* timeout before backing off */
+  int samples;            /* round trips measured */
+};
+
+/* set up r with timeout initial, adapting to the RTT if adaptive */
+extern void rtoinit(struct rto *r, bool adaptive, double initial);
+
+/* take rtt, measured on a packet that was sent only once, into r */
+extern void rtosample(struct rto *r, double rtt);
+
+/* the timeout for a packet that has already timed out backoff times */
+extern double rtotimeout(const struct rto *r, int backoff);
+
+/* true if an ACK that arrives elapsed after the packet was resent must
+   have been for an earlier copy of it, so the resend wasn't needed */
+extern bool rtospurious(const struct rto *r, double elapsed);
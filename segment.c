@@ -0,0 +1,50 @@
+#include <string.h>
+#include "emulator.h"
+#include "segment.h"
+
+/* ******************************************************************
+   Segmentation and reassembly.
+
+   A message from layer 5 larger than the payload of a packet is sent in
+   as many packets as it takes, each full but the last, and the receiver
+   puts the payloads of the packets it gets in order back together until
+   it has messagesize() bytes, which it passes to layer 5.  A message
+   that fits in one packet is passed on straight from it, without being
+   copied.  How the packets get there in order is up to the protocol.
+**********************************************************************/
+
+int segments(int length)
+{
+  return (length + payloadsize() - 1) / payloadsize();
+}
+
+void segment(struct pkt *packet, const struct msg *message, int i)
+{
+  int offset = i*payloadsize();
+
+  packet->length = message->length - offset;
+  if (packet->length > payloadsize())
+    packet->length = payloadsize();
+  memcpy(packet->payload, message->data + offset, packet->length);
+}
+
+void reassemblyinit(struct reassembly *r, char *storage)
+{
+  r->message = storage;
+  r->length = 0;
+}
+
+void reassemble(struct reassembly *r, int entity, const struct pkt *packet)
+{
+  /* a message that came in one packet is delivered straight from it */
+  if (r->length == 0 && packet->length == messagesize()) {
+    tolayer5(entity, packet->payload, packet->length);
+    return;
+  }
+  memcpy(r->message + r->length, packet->payload, packet->length);
+  r->length += packet->length;
+  if (r->length == messagesize()) {
+    tolayer5(entity, r->message, r->length);
+    r->length = 0;
+  }
+}
@@ -0,0 +1,21 @@
+/* messages split into packets and put back together, see segment.c */
+
+/* number of packets needed for a message of length bytes */
+extern int segments(int length);
+
+/* fill in the length and payload of packet with piece i of message */
+extern void segment(struct pkt *packet, const struct msg *message, int i);
+
+/* the message a receiver is putting back together, in messagesize()
+   bytes of storage the protocol provides */
+struct reassembly {
+  char *message;
+  int length;             /* bytes of it received so far */
+};
+
+/* set up r to put messages together in storage */
+extern void reassemblyinit(struct reassembly *r, char *storage);
+
+/* add the payload of the next packet in order to r, and pass the message
+   to layer 5 at entity once it is complete */
+extern void reassemble(struct reassembly *r, int entity, const struct pkt *packet);
@@ -1,11 +1,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include "emulator.h"
-#include "gbn.h"
+#include "protocol.h"
+#include "sr.h"
+#include "checksum.h"
+#include "rto.h"
+#include "backlog.h"
+#include "cc.h"
+#include "segment.h"
 
 /* ******************************************************************
-   Go Back N protocol.  Adapted from J.F.Kurose
+   Selective Repeat protocol.  Adapted from J.F.Kurose
    ALTERNATING BIT AND GO-BACK-N NETWORK EMULATOR: VERSION 1.2  
 
    Network properties:
@@ -14,262 +21,479 @@
    - packets can be corrupted (either the header or the data portion)
    or lost, according to user-defined probabilities
    - packets will be delivered in the order in which they were sent
-   (although some can be lost).
+   (although some can be lost), unless the medium is asked to hold
+   packets back or duplicate them
 
    Modifications: 
    - removed bidirectional GBN code and other code not used by prac. 
    - fixed C style to adhere to current programming style
-   - added GBN implementation
+   - added SR implementation: every packet is ACKed individually, the
+   receiver buffers out of order packets, and each packet in the send
+   window has its own logical timer so that on a timeout only that
+   packet is resent
+   - messages larger than a packet's payload are sent in several packets
+   and put back together by the receiver
+   - bidirectional transfer: both entities run a sender and a receiver,
+   and a receiver holds one ACK back for a moment, on the entity's own
+   timer, in the hope of sending it on a data packet
+   - the timeout can follow an estimate of the round trip time instead
+   of being fixed (see rto.c), doubling each time the packet is resent
+   - the window size and sequence space are set when the simulation is,
+   so windows of thousands of packets can be tried
+   - the entry points are reached through a struct protocol (see
+   protocol.c) rather than global A_ and B_ routines, so this engine and
+   the others can be linked into one program
 **********************************************************************/
 
-#define RTT  16.0       /* round trip time.  MUST BE SET TO 16.0 when submitting assignment */
-#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet */
-#define SEQSPACE 7      /* the min sequence space for GBN must be at least windowsize + 1 */
+#define RTT  16.0       /* round trip time, the timeout unless adaptiverto().  MUST BE SET TO 16.0 when submitting assignment */
+#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet, unless windowsize() is given */
+#define REORDERSEQSPACE 65536  /* sequence space unless seqspace() is given, if the medium reorders */
 #define NOTINUSE (-1)   /* used to fill header fields that are not being used */
-
-/* generic procedure to compute the checksum of a packet.  Used by both sender and receiver  
-   the simulator will overwrite part of your packet with 'z's.  It will not overwrite your 
-   original checksum.  This procedure must generate a different checksum to the original if
-   the packet is corrupted.
-*/
-int ComputeChecksum(struct pkt packet)
+#define ACKDELAY (RTT/8)  /* longest time an ACK waits for data to ride on */
+
+/* the sender and receiver of one entity.  Unless the simulation is
+   bidirectional only A's sender and B's receiver are used. */
+struct sr_entity {
+  /* sender */
+  bool *acked;                        /* which packets in buffer have been ACKed */
+  int windowfirst, windowlast;        /* array indexes of the first/last packet awaiting ACK */
+  int windowcount;                    /* the number of packets currently in the window */
+  int nextseqnum;                     /* the next sequence number to be used by the sender */
+  struct rto rto;                     /* the timeout and the round trip it follows */
+  double *senttime;                   /* when each packet in buffer was last sent */
+  int *resends;                       /* how many times each packet in buffer has been resent */
+  int backoff;                        /* the most any packet has timed out since the last round trip sample */
+  struct backlog backlog;             /* messages waiting for room in the window */
+  struct cc cc;                       /* the congestion window and how it changes */
+
+  /* receiver */
+  int expectedseqnum;                 /* the sequence number expected next by the receiver */
+  int ackseqnum;                      /* the sequence number for the next ACK sent on its own */
+  int ackpending;                     /* the packet whose ACK waits for data, or NOTINUSE */
+  int rcvfirst;                       /* rcvbuffer index of the packet with expectedseqnum */
+  bool *received;                     /* which slots of rcvbuffer hold a packet */
+  struct reassembly rcv;              /* the message being put back together */
+};
+
+/* the protocol keeps all of its state in the simulation (see
+   protocolstate()) rather than in globals */
+struct sr_state {
+  int windowsize;                     /* the maximum number of buffered unacked packets */
+  int seqspace;                       /* sequence numbers run from 0 to seqspace-1 */
+  struct sr_entity entity[2];         /* A and B */
+
+  /* followed, for A and then B, by the sender's window buffer and the
+     receiver's buffer of packets received out of order, windowsize
+     packets of pktsize() bytes each, then the backlogs of A and B, then
+     for both entities the arrays of the window slots (send times, resend
+     counts, acked and received flags), and then the messages being put
+     back together at A and B */
+};
+
+/* the window size of the simulation, or SR's own */
+static int window(void)
 {
-  int checksum = 0;
-  int i;
+  return windowsize() > 0 ? windowsize() : WINDOWSIZE;
+}
 
-  checksum = packet.seqnum;
-  checksum += packet.acknum;
-  for ( i=0; i<20; i++ ) 
-    checksum += (int)(packet.payload[i]);
+/* bytes of state for each window slot of an entity */
+static size_t slotsize(void)
+{
+  return 2*pktsize() + sizeof(double) + sizeof(int) + 2*sizeof(bool);
+}
 
-  return checksum;
+/* bytes of storage for each entity's backlog */
+static size_t backlogbytes(void)
+{
+  return backlogstorage(backlogsize(), messagesize());
 }
 
-bool IsCorrupted(struct pkt packet)
+static struct sr_state *srstate(void)
 {
-  if (packet.checksum == ComputeChecksum(packet))
-    return (false);
-  else
-    return (true);
+  return protocolstate(sizeof(struct sr_state) +
+                       2*(window()*slotsize() + backlogbytes() + messagesize()));
 }
 
+/* the packet in slot i of entity's window buffer */
+static struct pkt *buffer(struct sr_state *s, int entity, int i)
+{
+  return (struct pkt *)((char *)(s + 1) + (2*entity*s->windowsize + i)*pktsize());
+}
 
-/********* Sender (A) variables and functions ************/
+/* the packet in slot i of entity's receive buffer */
+static struct pkt *rcvbuffer(struct sr_state *s, int entity, int i)
+{
+  return (struct pkt *)((char *)(s + 1) + ((2*entity + 1)*s->windowsize + i)*pktsize());
+}
 
-static struct pkt buffer[WINDOWSIZE];  /* array for storing packets waiting for ACK */
-static int windowfirst, windowlast;    /* array indexes of the first/last packet awaiting ACK */
-static int windowcount;                /* the number of packets currently awaiting an ACK */
-static int A_nextseqnum;               /* the next sequence number to be used by the sender */
+/* the message being put back together at entity */
+static char *rcvmessage(struct sr_state *s, int entity)
+{
+  return (char *)(s + 1) + 2*(s->windowsize*slotsize() + backlogbytes()) + entity*messagesize();
+}
 
-/* called from layer 5 (application layer), passed the message to be sent to other side */
-void A_output(struct msg message)
+/* how far sequence number to is after from, allowing for wrap around */
+static int seqoffset(const struct sr_state *s, int from, int to)
 {
-  struct pkt sendpkt;
-  int i;
+  return (to - from + s->seqspace) % s->seqspace;
+}
 
-  /* if not blocked waiting on ACK */
-  if ( windowcount < WINDOWSIZE) {
-    if (TRACE > 1)
-      printf("----A: New message arrives, send window is not full, send new messge to layer3!\n");
+/* send a data packet of entity's sender, carrying the ACK waiting at its
+   receiver if there is one */
+static void senddata(struct sr_state *s, int entity, struct pkt *packet)
+{
+  struct sr_entity *e = &s->entity[entity];
 
-    /* create packet */
-    sendpkt.seqnum = A_nextseqnum;
-    sendpkt.acknum = NOTINUSE;
-    for ( i=0; i<20 ; i++ ) 
-      sendpkt.payload[i] = message.data[i];
-    sendpkt.checksum = ComputeChecksum(sendpkt); 
+  packet->acknum = e->ackpending;
+  if (e->ackpending != NOTINUSE) {
+    e->ackpending = NOTINUSE;
+    stoptimer(entity);
+    protocolstats()->ACKs_piggybacked++;
+  }
+  packet->checksum = ComputeChecksum(packet); 
+  tolayer3(entity, packet);
+}
 
-    /* put packet in window buffer */
-    /* windowlast will always be 0 for alternating bit; but not for GoBackN */
-    windowlast = (windowlast + 1) % WINDOWSIZE; 
-    buffer[windowlast] = sendpkt;
-    windowcount++;
+/* send ACK acknum from entity's receiver in a packet of its own */
+static void sendack(struct sr_state *s, int entity, int acknum)
+{
+  struct sr_entity *e = &s->entity[entity];
+  struct pkt sendpkt;
 
-    /* send out packet */
-    if (TRACE > 0)
-      printf("Sending packet %d to layer 3\n", sendpkt.seqnum);
-    tolayer3 (A, sendpkt);
+  /* create packet */
+  sendpkt.seqnum = e->ackseqnum;
+  sendpkt.acknum = acknum;
+  e->ackseqnum = (e->ackseqnum + 1) % 2;
+    
+  /* we don't have any data to send */
+  sendpkt.length = 0;
 
-    /* start timer if first packet in window */
-    if (windowcount == 1)
-      starttimer(A,RTT);
+  /* computer checksum */
+  sendpkt.checksum = ComputeChecksum(&sendpkt); 
 
-    /* get next sequence number, wrap back to 0 */
-    A_nextseqnum = (A_nextseqnum + 1) % SEQSPACE;  
-  }
-  /* if blocked,  window is full */
-  else {
-    if (TRACE > 0)
-      printf("----A: New message arrives, send window is full\n");
-    window_full++;
-  }
+  /* send out packet */
+  protocolstats()->ACKs_sent++;
+  tolayer3(entity, &sendpkt);
 }
 
+/********* Sender variables and functions ************/
 
-/* called from layer 3, when a packet arrives for layer 4 
-   In this practical this will always be an ACK as B never sends data.
-*/
-void A_input(struct pkt packet)
+/* true if a message of length bytes can be sent now: the window, as far
+   as congestion control allows, has room for all of its packets */
+static bool room(int entity, int length)
 {
-  int ackcount = 0;
-  int i;
+  struct sr_state *s = srstate();
 
-  /* if received ACK is not corrupted */ 
-  if (!IsCorrupted(packet)) {
-    if (TRACE > 0)
-      printf("----A: uncorrupted ACK %d is received\n",packet.acknum);
-    total_ACKs_received++;
-
-    /* check if new ACK or duplicate */
-    if (windowcount != 0) {
-          int seqfirst = buffer[windowfirst].seqnum;
-          int seqlast = buffer[windowlast].seqnum;
-          /* check case when seqnum has and hasn't wrapped */
-          if (((seqfirst <= seqlast) && (packet.acknum >= seqfirst && packet.acknum <= seqlast)) ||
-              ((seqfirst > seqlast) && (packet.acknum >= seqfirst || packet.acknum <= seqlast))) {
-
-            /* packet is a new ACK */
-            if (TRACE > 0)
-              printf("----A: ACK %d is not a duplicate\n",packet.acknum);
-            new_ACKs++;
-
-            /* cumulative acknowledgement - determine how many packets are ACKed */
-            if (packet.acknum >= seqfirst)
-              ackcount = packet.acknum + 1 - seqfirst;
-            else
-              ackcount = SEQSPACE - seqfirst + packet.acknum;
-
-	    /* slide window by the number of packets ACKed */
-            windowfirst = (windowfirst + ackcount) % WINDOWSIZE;
-
-            /* delete the acked packets from window buffer */
-            for (i=0; i<ackcount; i++)
-              windowcount--;
-
-	    /* start timer again if there are still more unacked packets in window */
-            stoptimer(A);
-            if (windowcount > 0)
-              starttimer(A, RTT);
-
-          }
-        }
-        else
-          if (TRACE > 0)
-        printf ("----A: duplicate ACK received, do nothing!\n");
-  }
-  else 
-    if (TRACE > 0)
-      printf ("----A: corrupted ACK is received, do nothing!\n");
+  return ccroom(&s->entity[entity].cc, s->windowsize, s->entity[entity].windowcount,
+                segments(length));
 }
 
-/* called when A's timer goes off */
-void A_timerinterrupt(void)
+/* send message in the next packets of entity's window, which has room for it */
+static void sendmessage(int entity, const struct msg *message)
 {
+  struct sr_state *s = srstate();
+  struct sr_entity *e = &s->entity[entity];
+  struct pkt *sendpkt;
+  int nsegments = segments(message->length);
   int i;
 
-  if (TRACE > 0)
-    printf("----A: time out,resend packets!\n");
+  for (i=0; i<nsegments; i++) {
+    /* create packet for the next piece of the message, in place in the window buffer */
+    e->windowlast = (e->windowlast + 1) % s->windowsize; 
+    sendpkt = buffer(s, entity, e->windowlast);
+    sendpkt->seqnum = e->nextseqnum;
+    segment(sendpkt, message, i);
+    e->acked[e->windowlast] = false;
+    e->senttime[e->windowlast] = simtime();
+    e->resends[e->windowlast] = 0;
+    e->windowcount++;
 
-  for(i=0; i<windowcount; i++) {
+    /* send out packet */
+    if (TRACING(0))
+      printf("Sending packet %d to layer 3\n", sendpkt->seqnum);
+    senddata(s, entity, sendpkt);
+    protocolstats()->packets_sent++;
+    ccsent(&e->cc, e->windowcount);
 
-    if (TRACE > 0)
-      printf ("---A: resending packet %d\n", (buffer[(windowfirst+i) % WINDOWSIZE]).seqnum);
+    /* every packet has its own timer, named after its window slot */
+    startidtimer(entity, e->windowlast, rtotimeout(&e->rto, e->backoff));
 
-    tolayer3(A,buffer[(windowfirst+i) % WINDOWSIZE]);
-    packets_resent++;
-    if (i==0) starttimer(A,RTT);
+    /* get next sequence number, wrap back to 0 */
+    e->nextseqnum = (e->nextseqnum + 1) % s->seqspace;  
   }
-}       
-
+}
 
+static const struct sender sender = { room, sendmessage };
 
-/* the following routine will be called once (only) before any other */
-/* entity A routines are called. You can use it to do any initialization */
-void A_init(void)
+/* called from layer 5 (application layer), passed the message to be sent
+   to other side.  It waits in the backlog if the window has no room */
+static void output(int entity, const struct msg *message)
 {
-  /* initialise A's window, buffer and sequence number */
-  A_nextseqnum = 0;  /* A starts with seq num 0, do not change this */
-  windowfirst = 0;
-  windowlast = -1;   /* windowlast is where the last packet sent is stored.  
-		     new packets are placed in winlast + 1 
-		     so initially this is set to -1
-		   */
-  windowcount = 0;
+  backlogoutput(&srstate()->entity[entity].backlog, &sender, entity, message);
 }
 
 
+/* called when an uncorrupted packet carrying ACK acknum arrives for entity's sender */
+static void ackinput(struct sr_state *s, int entity, int acknum)
+{
+  struct sr_entity *e = &s->entity[entity];
+  int offset, slot, slid;
+
+  if (TRACING(0))
+    printf("----%c: uncorrupted ACK %d is received\n", 'A'+entity, acknum);
+  protocolstats()->total_ACKs_received++;
+
+  /* position of the ACKed packet in the window, if it is in there */
+  offset = seqoffset(s, buffer(s, entity, e->windowfirst)->seqnum, acknum);
+  slot = (e->windowfirst + offset) % s->windowsize;
+
+  if (offset < e->windowcount && !e->acked[slot]) {
+
+    /* packet is a new ACK */
+    if (TRACING(0))
+      printf("----%c: ACK %d is not a duplicate\n", 'A'+entity, acknum);
+    protocolstats()->new_ACKs++;
+    e->acked[slot] = true;
+    stopidtimer(entity, slot);
+
+    /* a packet sent once times the round trip, and until one does the
+       timeout stays backed off, new packets included; a resent one ACKed
+       too soon for the resend to have got there was a spurious resend */
+    if (e->resends[slot] == 0) {
+      rtosample(&e->rto, simtime() - e->senttime[slot]);
+      e->backoff = 0;
+    }
+    else if (rtospurious(&e->rto, simtime() - e->senttime[slot]))
+      protocolstats()->spurious_resends++;
+
+    /* individual acknowledgement - the window only slides once the
+       oldest packet is ACKed, and then past every ACKed packet after it */
+    for (slid = 0; e->windowcount > 0 && e->acked[e->windowfirst]; slid++) {
+      e->windowfirst = (e->windowfirst + 1) % s->windowsize;
+      e->windowcount--;
+    }
+
+    /* an ACK beyond a packet not yet ACKed is congestion control's
+       duplicate ACK.  Once the window has moved on congestion control
+       may open it further, and what was waiting is sent in the room made */
+    if (slid == 0)
+      ccdupack(&e->cc);
+    else {
+      ccacked(&e->cc, slid, e->rto.srtt);
+      backlogdrain(&e->backlog, &sender, entity);
+    }
+  }
+  else
+    if (TRACING(0))
+      printf ("----%c: duplicate ACK received, do nothing!\n", 'A'+entity);
+}
 
-/********* Receiver (B)  variables and procedures ************/
+/* called when the timer for the packet in window slot timerid goes off */
+static void timeout(int entity, int timerid)
+{
+  struct sr_state *s = srstate();
+  struct sr_entity *e = &s->entity[entity];
+
+  if (TRACING(0))
+    printf("----%c: time out,resend packets!\n", 'A'+entity);
+
+  /* only this packet has timed out */
+  if (TRACING(0))
+    printf ("---%c: resending packet %d\n", 'A'+entity, buffer(s, entity, timerid)->seqnum);
+
+  cctimeout(&e->cc, e->windowcount, (timerid - e->windowfirst + s->windowsize) % s->windowsize);
+  senddata(s, entity, buffer(s, entity, timerid));
+  e->senttime[timerid] = simtime();
+  e->resends[timerid]++;
+  if (e->backoff < e->resends[timerid])
+    e->backoff = e->resends[timerid];
+  protocolstats()->packets_resent++;
+  startidtimer(entity, timerid, rtotimeout(&e->rto, e->backoff));
+}       
 
-static int expectedseqnum; /* the sequence number expected next by the receiver */
-static int B_nextseqnum;   /* the sequence number for the next packets sent by B */
+/********* Receiver variables and procedures ************/
 
 
-/* called from layer 3, when a packet arrives for layer 4 at B*/
-void B_input(struct pkt packet)
+/* ACK packet seqnum.  In a bidirectional simulation the ACK waits up to
+   ACKDELAY for data to ride on; only one ACK waits at a time, so the one
+   waiting before is sent on its own */
+static void ack(struct sr_state *s, int entity, int seqnum)
 {
-  struct pkt sendpkt;
-  int i;
-
-  /* if not corrupted and received packet is in order */
-  if  ( (!IsCorrupted(packet))  && (packet.seqnum == expectedseqnum) ) {
-    if (TRACE > 0)
-      printf("----B: packet %d is correctly received, send ACK!\n",packet.seqnum);
-    packets_received++;
-
-    /* deliver to receiving application */
-    tolayer5(B, packet.payload);
+  struct sr_entity *e = &s->entity[entity];
 
-    /* send an ACK for the received packet */
-    sendpkt.acknum = expectedseqnum;
+  if (!bidirectional()) {
+    sendack(s, entity, seqnum);
+    return;
+  }
+  if (e->ackpending == NOTINUSE)
+    starttimer(entity, ACKDELAY);
+  else
+    sendack(s, entity, e->ackpending);
+  e->ackpending = seqnum;
+}
 
-    /* update state variables */
-    expectedseqnum = (expectedseqnum + 1) % SEQSPACE;        
+/* called when an uncorrupted data packet arrives for entity's receiver */
+static void datainput(struct sr_state *s, int entity, const struct pkt *packet)
+{
+  struct sr_entity *e = &s->entity[entity];
+  int offset, slot;
+
+  /* position of the packet relative to the receive window */
+  offset = seqoffset(s, e->expectedseqnum, packet->seqnum);
+  slot = (e->rcvfirst + offset) % s->windowsize;
+
+  if (offset < s->windowsize) {
+    /* in the window: buffer it unless we already have it */
+    if (!e->received[slot]) {
+      if (TRACING(0))
+        printf("----%c: packet %d is correctly received, send ACK!\n", 'A'+entity, packet->seqnum);
+      protocolstats()->packets_received++;
+      memcpy(rcvbuffer(s, entity, slot), packet,
+             offsetof(struct pkt, payload) + packet->length);
+      e->received[slot] = true;
+    }
+    else if (TRACING(0))
+      printf("----%c: duplicate packet %d received, resend ACK!\n", 'A'+entity, packet->seqnum);
+
+    /* deliver the run of packets now in order to the receiving application */
+    while (e->received[e->rcvfirst]) {
+      reassemble(&e->rcv, entity, rcvbuffer(s, entity, e->rcvfirst));
+      e->received[e->rcvfirst] = false;
+      e->rcvfirst = (e->rcvfirst + 1) % s->windowsize;
+      e->expectedseqnum = (e->expectedseqnum + 1) % s->seqspace;
+    }
   }
-  else {
-    /* packet is corrupted or out of order resend last ACK */
-    if (TRACE > 0) 
-      printf("----B: packet corrupted or not expected sequence number, resend ACK!\n");
-    if (expectedseqnum == 0)
-      sendpkt.acknum = SEQSPACE - 1;
-    else
-      sendpkt.acknum = expectedseqnum - 1;
+  else if (offset >= s->seqspace - s->windowsize) {
+    /* already delivered, our ACK must have been lost: ACK it again */
+    if (TRACING(0))
+      printf("----%c: packet %d already delivered, resend ACK!\n", 'A'+entity, packet->seqnum);
   }
+  else
+    return;
 
-  /* create packet */
-  sendpkt.seqnum = B_nextseqnum;
-  B_nextseqnum = (B_nextseqnum + 1) % 2;
-    
-  /* we don't have any data to send.  fill payload with 0's */
-  for ( i=0; i<20 ; i++ ) 
-    sendpkt.payload[i] = '0';  
+  ack(s, entity, packet->seqnum);
+}
 
-  /* computer checksum */
-  sendpkt.checksum = ComputeChecksum(sendpkt); 
+/* called from layer 3, when a packet arrives for layer 4 at entity.  It
+   carries an ACK for the sender, data for the receiver, or both */
+static void input(int entity, const struct pkt *packet)
+{
+  struct sr_state *s = srstate();
 
-  /* send out packet */
-  tolayer3 (B, sendpkt);
+  /* corrupted packets are not ACKed; the sender will time out and resend */
+  if (IsCorrupted(packet)) {
+    if (TRACING(0)) 
+      printf("----%c: corrupted packet is received, do nothing!\n", 'A'+entity);
+    return;
+  }
+  if (packet->acknum != NOTINUSE)
+    ackinput(s, entity, packet->acknum);
+  if (packet->length > 0)
+    datainput(s, entity, packet);
 }
 
-/* the following routine will be called once (only) before any other */
-/* entity B routines are called. You can use it to do any initialization */
-void B_init(void)
+/* called when entity's ACK has waited ACKDELAY without data to ride on */
+static void acktimeout(int entity)
 {
-  expectedseqnum = 0;
-  B_nextseqnum = 1;
+  struct sr_state *s = srstate();
+  struct sr_entity *e = &s->entity[entity];
+  int acknum = e->ackpending;
+
+  if (acknum == NOTINUSE)
+    return;
+  e->ackpending = NOTINUSE;
+  sendack(s, entity, acknum);
 }
 
-/******************************************************************************
- * The following functions need be completed only for bi-directional messages *
- *****************************************************************************/
+/* take the window size and sequence space of the simulation, or SR's
+   own, with a sequence space of twice the window unless one is given.
+   The min sequence space for SR must be at least 2 * windowsize, or the
+   receiver can't tell a resent packet from a new one.
+   -1 if the window doesn't fit in the sequence space */
+static int windowinit(struct sr_state *s)
+{
+  s->windowsize = window();
+
+  /* twice the window is enough if packets stay in order; if they don't,
+     a large space keeps a packet held back from being taken for a later
+     one with the same number (see gbn.c) */
+  if (seqspace() > 0)
+    s->seqspace = seqspace();
+  else if (reordering() && 2*s->windowsize < REORDERSEQSPACE)
+    s->seqspace = REORDERSEQSPACE;
+  else
+    s->seqspace = 2*s->windowsize;
+  if (s->windowsize < 1 || s->seqspace < 2*s->windowsize) {
+    fprintf(stderr, "a window of %d packets needs a sequence space of at least %d, not %d.\n",
+            s->windowsize, 2*s->windowsize, s->seqspace);
+    return -1;
+  }
+  return 0;
+}
 
-/* Note that with simplex transfer from a-to-B, there is no B_output() */
-void B_output(struct msg message)  
+/* set up the sender and receiver of entity, -1 if the window is not valid */
+static int entityinit(int entity)
 {
+  struct sr_state *s = srstate();
+  struct sr_entity *e = &s->entity[entity];
+  char *slots;
+  int w;
+
+  if (s->windowsize == 0 && windowinit(s) < 0)
+    return -1;
+
+  /* the backlogs and then the arrays of the window slots of A and B,
+     after their buffers */
+  w = s->windowsize;
+  slots = (char *)(s + 1) + 4*w*pktsize();
+  backloginit(&e->backlog, slots + entity*backlogbytes(), backlogsize(), messagesize());
+  slots += 2*backlogbytes();
+  e->senttime = (double *)slots + entity*w;
+  slots += 2*w*sizeof(double);
+  e->resends = (int *)slots + entity*w;
+  slots += 2*w*sizeof(int);
+  e->acked = (bool *)slots + entity*w;
+  slots += 2*w*sizeof(bool);
+  e->received = (bool *)slots + entity*w;
+
+  /* initialise the window, buffer and sequence number */
+  e->nextseqnum = 0;  /* A starts with seq num 0, do not change this */
+  e->windowfirst = 0;
+  e->windowlast = -1;   /* windowlast is where the last packet sent is stored.  
+		     new packets are placed in winlast + 1 
+		     so initially this is set to -1
+		   */
+  e->windowcount = 0;
+  rtoinit(&e->rto, adaptiverto(), RTT);
+  e->backoff = 0;
+  ccinit(&e->cc, congestioncontrol(), entity);
+
+  e->expectedseqnum = 0;
+  e->ackseqnum = 1;
+  e->ackpending = NOTINUSE;
+  e->rcvfirst = 0;
+  reassemblyinit(&e->rcv, rcvmessage(s, entity));
+  return 0;
 }
 
-/* called when B's timer goes off */
-void B_timerinterrupt(void)
+/********* Entry points called by the emulator ************/
+
+/* called once (only) for each entity before any of its other routines.
+   -1 if the window is not valid or too small for a message */
+static int srinit(int entity)
 {
+  if (entityinit(entity) < 0)
+    return -1;
+  if (entity == A && segments(messagesize()) > srstate()->windowsize) {
+    fprintf(stderr, "a message needs %d packets but the window holds only %d.\n",
+            segments(messagesize()), srstate()->windowsize);
+    return -1;
+  }
+  return 0;
 }
 
+/* SR only uses the entity's timer for the ACK waiting for data, and the
+   logical timers for the packets in the window, one per window slot */
+const struct protocol srprotocol = {
+  "sr", srinit, output, input, acktimeout, timeout
+};
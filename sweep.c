@@ -0,0 +1,489 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "emulator.h"
+#include "protocol.h"
+#include "link.h"
+#include "sweep.h"
+
+/* ******************************************************************
+   Parameter sweeps.
+
+   Runs one simulation for every point of a grid of parameters, spread
+   over all cores, and writes one CSV row of statistics per point:
+
+     emulator -sweep [-j threads] [-o file] [-f gridfile] key=values ...
+
+   values is a comma separated list (0,0.1,0.2) or a range written
+   first:last:step (0:0.3:0.05), and key is one of
+
+     msgs     number of messages to simulate
+     loss     packet loss probability
+     corrupt  packet corruption probability
+     dir      direction of loss and corruption: 0 A->B, 1 A<-B, 2 both
+     lambda   average time between messages from layer 5
+     seed     seed of the random number generators
+     payload  bytes of payload a packet can carry
+     msgsize  bytes in each message from layer 5
+     bidir    1 if B sends messages to A as well
+     flows    number of A,B pairs simulated together (msgs is per flow)
+     bottleneck  1 if the flows share one medium each way
+     rto      0 for a fixed retransmission timeout, 1 for one following the RTT
+     window   packets a sender may have unACKed, 0 for the protocol's own
+     seqspace sequence numbers used, 0 for the protocol's own
+     backlog  messages a sender may hold while its window is full
+     cc       congestion control: 0 none, 1 AIMD, 2 Cubic
+     protocol protocol engine, by name (gbn, sr) or PROTO_ code
+     bandwidth  bytes per time unit a link carries, 0 for the unlimited medium
+     delay    time a packet takes along such a link once sent
+     queue    packets its router queue holds, 0 for no limit
+     aqm      queue discipline: 0 drop-tail, 1 RED, 2 CoDel
+     burst    probability the channel turns bad (Gilbert-Elliott), 0 for
+              independent losses
+     burstend probability it turns good again
+     burstloss  loss probability while bad (loss is the one while good)
+     reorder  probability a packet is held back, letting others past
+     reorderdelay  most time it is held back for
+     reorderdir  direction of reordering, as dir
+     dup      probability a packet arrives twice
+     dupdir   direction of duplication, as dir
+
+   Keys that are not given keep the default value below.  A grid file
+   holds the same key=values words, any number per line; # starts a
+   comment.  Simulations in a sweep run with TRACE 0.
+
+   A point whose parameters are not valid (a window too big for its
+   sequence space, say) is reported on stderr and gets a row with status
+   invalid and no statistics; the rest of the sweep still runs.
+
+   The points are dealt out to the worker threads in equal contiguous
+   ranges.  A worker that finishes its range steals the upper half of the
+   largest range left, so a few slow points do not leave cores idle.
+
+   build: make emulator
+**********************************************************************/
+
+#define NAXES 29
+#define PROTOCOLAXIS 16    /* the axis whose values may be names */
+#define MAXLINE 1024
+#define NSTATS 37          /* CSV columns of statistics, after status */
+
+/* one parameter of the grid and the values it takes */
+struct axis {
+  const char *key;
+  double dflt;            /* the value if the key is not given */
+  double *values;
+  int count;
+};
+
+static struct axis axes[NAXES] = {
+  { "msgs",    1000, NULL, 0 },
+  { "loss",     0.0, NULL, 0 },
+  { "corrupt",  0.0, NULL, 0 },
+  { "dir",        2, NULL, 0 },
+  { "lambda",  10.0, NULL, 0 },
+  { "seed",    9999, NULL, 0 },
+  { "payload",   20, NULL, 0 },
+  { "msgsize",   20, NULL, 0 },
+  { "bidir",      0, NULL, 0 },
+  { "flows",      1, NULL, 0 },
+  { "bottleneck", 0, NULL, 0 },
+  { "rto",        0, NULL, 0 },
+  { "window",     0, NULL, 0 },
+  { "seqspace",   0, NULL, 0 },
+  { "backlog",    0, NULL, 0 },
+  { "cc",         0, NULL, 0 },
+  { "protocol",   PROTO_GBN, NULL, 0 },
+  { "bandwidth",  0, NULL, 0 },
+  { "delay",      LINKDELAY, NULL, 0 },
+  { "queue",      0, NULL, 0 },
+  { "aqm",        QUEUE_DROPTAIL, NULL, 0 },
+  { "burst",      0.0, NULL, 0 },
+  { "burstend",   0.0, NULL, 0 },
+  { "burstloss",  1.0, NULL, 0 },
+  { "reorder",    0.0, NULL, 0 },
+  { "reorderdelay", REORDERDELAY, NULL, 0 },
+  { "reorderdir",   2, NULL, 0 },
+  { "dup",        0.0, NULL, 0 },
+  { "dupdir",       2, NULL, 0 },
+};
+
+/* a worker thread and the points it still has to run */
+struct worker {
+  pthread_t thread;
+  pthread_mutex_t lock;   /* protects next and end */
+  long next, end;         /* points [next, end) */
+};
+
+static struct worker *workers;
+static int nworkers;
+static long npoints;
+static struct sim_stats *results;   /* indexed by point */
+static bool *invalid;               /* points whose parameters are not valid */
+
+/* the PROTO_ code of the protocol named at v, up to a comma or the end,
+   with end set after the name; -1 if there is no such protocol */
+static double protocolvalue(const char *v, char **end)
+{
+  char name[MAXLINE];
+  size_t n = strcspn(v, ",");
+
+  if (n >= sizeof(name))
+    return -1;
+  memcpy(name, v, n);
+  name[n] = '\0';
+  *end = (char *)v + n;
+  return findprotocol(name);
+}
+
+/* add the values of a key=values word to its axis, -1 if it isn't valid */
+static int parseaxis(const char *word)
+{
+  const char *eq = strchr(word, '=');
+  struct axis *ax = NULL;
+  double first, last, step, *values;
+  char *end;
+  const char *v;
+  int i, n;
+
+  if (eq == NULL)
+    return -1;
+  for (i=0; i<NAXES; i++)
+    if (strlen(axes[i].key) == (size_t)(eq - word) &&
+        strncmp(axes[i].key, word, eq - word) == 0)
+      ax = &axes[i];
+  if (ax == NULL)
+    return -1;
+
+  v = eq + 1;
+  if (sscanf(v, "%lf:%lf:%lf", &first, &last, &step) == 3) {
+    if (step <= 0.0 || last < first)
+      return -1;
+    n = (int)((last - first) / step + 1e-9) + 1;
+    values = realloc(ax->values, (ax->count + n) * sizeof(double));
+    if (values == 0)
+      return -1;
+    ax->values = values;
+    for (i=0; i<n; i++)
+      ax->values[ax->count++] = first + i*step;
+    return 0;
+  }
+  for (;;) {
+    first = strtod(v, &end);
+    if (end == v && ax == &axes[PROTOCOLAXIS] && (first = protocolvalue(v, &end)) < 0)
+      return -1;
+    if (end == v || (*end != ',' && *end != '\0'))
+      return -1;
+    values = realloc(ax->values, (ax->count + 1) * sizeof(double));
+    if (values == 0)
+      return -1;
+    ax->values = values;
+    ax->values[ax->count++] = first;
+    if (*end == '\0')
+      return 0;
+    v = end + 1;
+  }
+}
+
+/* read the key=values words of a grid file, -1 on error */
+static int parsegridfile(const char *name)
+{
+  char line[MAXLINE], *word, *hash;
+  FILE *f;
+
+  f = fopen(name, "r");
+  if (f == NULL) {
+    fprintf(stderr, "sweep: cannot open grid file %s\n", name);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if ((hash = strchr(line, '#')) != NULL)
+      *hash = '\0';
+    for (word = strtok(line, " \t\r\n"); word != NULL; word = strtok(NULL, " \t\r\n"))
+      if (parseaxis(word) < 0) {
+        fprintf(stderr, "sweep: bad grid entry %s in %s\n", word, name);
+        fclose(f);
+        return -1;
+      }
+  }
+  fclose(f);
+  return 0;
+}
+
+/* the parameters at point p of the grid; the first axis varies slowest */
+static void pointparams(long p, struct sim_params *params)
+{
+  double v[NAXES];
+  int i;
+
+  for (i=NAXES-1; i>=0; i--) {
+    v[i] = axes[i].values[p % axes[i].count];
+    p /= axes[i].count;
+  }
+  params->nsimmax = (int)v[0];
+  params->lossprob = v[1];
+  params->corruptprob = v[2];
+  params->corruptdirection = (int)v[3];
+  params->lambda = v[4];
+  params->seed = (unsigned long)v[5];
+  params->tracefile = NULL;
+  params->payloadsize = (int)v[6];
+  params->msgsize = (int)v[7];
+  params->bidirectional = (int)v[8] != 0;
+  params->nflows = (int)v[9];
+  params->bottleneck = (int)v[10] != 0;
+  params->adaptiverto = (int)v[11] != 0;
+  params->windowsize = (int)v[12];
+  params->seqspace = (int)v[13];
+  params->backlog = (int)v[14];
+  params->congestion = (int)v[15];
+  params->protocol = (int)v[16];
+  params->bandwidth = v[17];
+  params->linkdelay = v[18];
+  params->queuelimit = (int)v[19];
+  params->aqm = (int)v[20];
+  params->burstprob = v[21];
+  params->burstend = v[22];
+  params->burstloss = v[23];
+  params->reorderprob = v[24];
+  params->reorderdelay = v[25];
+  params->reorderdirection = (int)v[26];
+  params->dupprob = v[27];
+  params->dupdirection = (int)v[28];
+  params->trace = 0;
+}
+
+static void runpoint(long p)
+{
+  struct sim_params params;
+  struct sim_context *sim;
+
+  pointparams(p, &params);
+  sim = sim_create(&params);
+  if (sim == NULL) {
+    invalid[p] = true;
+    return;
+  }
+  if (sim_run(sim) < 0)
+    invalid[p] = true;
+  else
+    results[p] = *sim_getstats(sim);
+  sim_destroy(sim);
+}
+
+/* take the next point from the worker's own range, -1 if it is empty */
+static long takepoint(struct worker *w)
+{
+  long p = -1;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->next < w->end)
+    p = w->next++;
+  pthread_mutex_unlock(&w->lock);
+  return p;
+}
+
+/* steal the upper half of the largest range any other worker has left,
+   returning its first point and keeping the rest; -1 if all are empty */
+static long stealpoint(struct worker *w)
+{
+  struct worker *victim;
+  long left, most, mid;
+  int i;
+
+  for (;;) {
+    victim = NULL;
+    most = 0;
+    for (i=0; i<nworkers; i++) {
+      if (&workers[i] == w)
+        continue;
+      pthread_mutex_lock(&workers[i].lock);
+      left = workers[i].end - workers[i].next;
+      pthread_mutex_unlock(&workers[i].lock);
+      if (left > most) {
+        most = left;
+        victim = &workers[i];
+      }
+    }
+    if (victim == NULL)
+      return -1;
+
+    pthread_mutex_lock(&victim->lock);
+    left = victim->end - victim->next;
+    if (left <= 0) {            /* someone got there first, look again */
+      pthread_mutex_unlock(&victim->lock);
+      continue;
+    }
+    mid = victim->next + left/2;
+    pthread_mutex_lock(&w->lock);
+    w->next = mid + 1;
+    w->end = victim->end;
+    pthread_mutex_unlock(&w->lock);
+    victim->end = mid;
+    pthread_mutex_unlock(&victim->lock);
+    return mid;
+  }
+}
+
+static void *workerloop(void *arg)
+{
+  struct worker *w = arg;
+  long p;
+
+  while ((p = takepoint(w)) >= 0 || (p = stealpoint(w)) >= 0)
+    runpoint(p);
+  return NULL;
+}
+
+/* the name of protocol p, which may not be a valid PROTO_ code */
+static const char *protocolname(int p)
+{
+  return p >= 0 && p < NPROTOCOLS ? protocols[p]->name : "unknown";
+}
+
+static void writeresults(FILE *out)
+{
+  struct sim_params params;
+  const struct sim_stats *st;
+  long p;
+  int i;
+
+  fprintf(out, "msgs,loss,corrupt,dir,lambda,seed,payload,msgsize,bidir,flows,bottleneck,rto,window,seqspace,backlog,cc,protocol,"
+          "bandwidth,delay,queue,aqm,burst,burstend,burstloss,reorder,reorderdelay,reorderdir,"
+          "dup,dupdir,status,endtime,nsim,"
+          "window_full,total_ACKs_received,new_ACKs,packets_resent,packets_received,"
+          "ACKs_sent,ACKs_piggybacked,spurious_resends,"
+          "messages_delivered,ntolayer3,nlost,ncorrupt,nreordered,nduplicated,latency_mean,"
+          "latency_p50,latency_p99,latency_p999,latency_max,goodput,goodput_bytes,"
+          "retransmit_ratio,inflight_mean,inflight_peak,backlogged,backlog_mean,backlog_delay,"
+          "backlog_peak,queue_drops,queue_mean,queue_delay,queue_peak,fairness,flow_goodput_min,flow_goodput_max\n");
+  for (p=0; p<npoints; p++) {
+    pointparams(p, &params);
+    st = &results[p];
+    fprintf(out, "%d,%g,%g,%d,%g,%lu,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%s,"
+            "%g,%g,%d,%d,%g,%g,%g,%g,%g,%d,%g,%d,",
+            params.nsimmax, params.lossprob, params.corruptprob,
+            params.corruptdirection, params.lambda, params.seed,
+            params.payloadsize, params.msgsize, params.bidirectional,
+            params.nflows, params.bottleneck, params.adaptiverto,
+            params.windowsize, params.seqspace, params.backlog, params.congestion,
+            protocolname(params.protocol), params.bandwidth, params.linkdelay,
+            params.queuelimit, params.aqm, params.burstprob, params.burstend,
+            params.burstloss, params.reorderprob, params.reorderdelay,
+            params.reorderdirection, params.dupprob, params.dupdirection);
+    if (invalid[p]) {
+      fputs("invalid", out);
+      for (i=0; i<NSTATS; i++)
+        fputc(',', out);
+      fputc('\n', out);
+      continue;
+    }
+    fprintf(out, "ok,%f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,"
+            "%f,%f,%f,%f,%f,%f,%f,%f,%f,%d,%d,%f,%f,%d,%d,%f,%f,%d,%f,%f,%f\n",
+            st->endtime, st->nsim, st->window_full, st->total_ACKs_received,
+            st->new_ACKs, st->packets_resent, st->packets_received,
+            st->ACKs_sent, st->ACKs_piggybacked, st->spurious_resends,
+            st->messages_delivered, st->ntolayer3, st->nlost, st->ncorrupt,
+            st->nreordered, st->nduplicated,
+            st->latency_mean, st->latency_p50, st->latency_p99,
+            st->latency_p999, st->latency_max, st->goodput, st->goodput_bytes,
+            st->retransmit_ratio, st->inflight_mean, st->inflight_peak,
+            st->backlogged, st->backlog_mean, st->backlog_delay, st->backlog_peak,
+            st->queue_drops, st->queue_mean, st->queue_delay, st->queue_peak,
+            st->fairness, st->flow_goodput_min, st->flow_goodput_max);
+  }
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: emulator -sweep [-j threads] [-o file] [-f gridfile] key=values ...\n"
+          "  keys: msgs loss corrupt dir lambda seed payload msgsize bidir flows bottleneck rto\n"
+          "        window seqspace backlog cc protocol bandwidth delay queue aqm\n"
+          "        burst burstend burstloss reorder reorderdelay reorderdir dup dupdir\n"
+          "  values: v1,v2,... or first:last:step\n");
+}
+
+int sweep_main(int argc, char *argv[])
+{
+  const char *outname = NULL;
+  FILE *out = stdout;
+  long share;
+  int i, status = EXIT_SUCCESS;
+
+  nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  for (i=1; i<argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i+1 < argc)
+      nworkers = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-o") == 0 && i+1 < argc)
+      outname = argv[++i];
+    else if (strcmp(argv[i], "-f") == 0 && i+1 < argc) {
+      if (parsegridfile(argv[++i]) < 0)
+        return EXIT_FAILURE;
+    }
+    else if (parseaxis(argv[i]) < 0) {
+      fprintf(stderr, "sweep: bad argument %s\n", argv[i]);
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (nworkers < 1)
+    nworkers = 1;
+
+  npoints = 1;
+  for (i=0; i<NAXES; i++) {
+    if (axes[i].count == 0) {
+      axes[i].values = malloc(sizeof(double));
+      if (axes[i].values == 0) {
+        fprintf(stderr, "sweep: memory allocation failed\n");
+        return EXIT_FAILURE;
+      }
+      axes[i].values[axes[i].count++] = axes[i].dflt;
+    }
+    npoints *= axes[i].count;
+  }
+  if (nworkers > npoints)
+    nworkers = (int)npoints;
+
+  if (outname != NULL && (out = fopen(outname, "w")) == NULL) {
+    fprintf(stderr, "sweep: cannot open %s\n", outname);
+    return EXIT_FAILURE;
+  }
+  results = calloc(npoints, sizeof(struct sim_stats));
+  invalid = calloc(npoints, sizeof(bool));
+  workers = calloc(nworkers, sizeof(struct worker));
+  if (results == 0 || invalid == 0 || workers == 0) {
+    fprintf(stderr, "sweep: memory allocation failed\n");
+    return EXIT_FAILURE;
+  }
+
+  /* deal out the points, then let the workers sort out the imbalance */
+  share = npoints / nworkers;
+  for (i=0; i<nworkers; i++) {
+    pthread_mutex_init(&workers[i].lock, NULL);
+    workers[i].next = i*share;
+    workers[i].end = (i == nworkers-1) ? npoints : (i+1)*share;
+  }
+  for (i=0; i<nworkers; i++)
+    if (pthread_create(&workers[i].thread, NULL, workerloop, &workers[i]) != 0) {
+      fprintf(stderr, "sweep: cannot start worker thread\n");
+      exit(EXIT_FAILURE);
+    }
+  for (i=0; i<nworkers; i++)
+    pthread_join(workers[i].thread, NULL);
+
+  writeresults(out);
+  if (out != stdout && fclose(out) != 0)
+    status = EXIT_FAILURE;
+
+  for (i=0; i<nworkers; i++)
+    pthread_mutex_destroy(&workers[i].lock);
+  for (i=0; i<NAXES; i++)
+    free(axes[i].values);
+  free(workers);
+  free(results);
+  free(invalid);
+  return status;
+}
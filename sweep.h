@@ -0,0 +1,3 @@
+/* run a parameter sweep described by the command line arguments (see
+   sweep.c), returns the exit status for main() */
+extern int sweep_main(int argc, char *argv[]);
@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+/* binary trace files.  A simulation run with a trace file (see
+   sim_params) appends one fixed size record per emulator event to it, in
+   the byte order of the machine, after the TRACEMAGIC header.  tracedump
+   turns a trace file back into the lines the emulator prints. */
+
+#define TRACEMAGIC "EMTRACE3"   /* the first 8 bytes of a trace file */
+
+/* record kinds */
+#define TR_EVENT       0   /* event taken off the queue: type in checksum,
+                              timer id in seqnum */
+#define TR_ARRIVAL     1   /* next message arrival being created */
+#define TR_MESSAGE     2   /* message given to the sender */
+#define TR_NOMORE      3   /* message arrival after the last message */
+#define TR_TOLAYER3    4   /* packet sent into the network */
+#define TR_LOST        5   /* ... and lost */
+#define TR_CORRUPT     6   /* ... and corrupted */
+#define TR_SCHEDULE    7   /* ... and scheduled to arrive */
+#define TR_TOLAYER5    8   /* data delivered to the application */
+#define TR_STARTTIMER  9   /* timer started: timer id in seqnum, -1 for the
+                              entity's timer */
+#define TR_STOPTIMER  10   /* timer stopped, as TR_STARTTIMER */
+#define TR_RESTARTTIMER 11 /* entity's timer restarted */
+#define TR_CWND       12   /* congestion window changed: cwnd and ssthresh
+                              in thousandths of a packet in seqnum and
+                              acknum, ssthresh -1 if there is none */
+#define TR_DROP       13   /* packet sent into the network dropped by the
+                              router queue: packets queued in seqnum */
+#define TR_REORDER    14   /* ... and held back */
+#define TR_DUPLICATE  15   /* ... and duplicated */
+
+struct tracerec {
+  double time;            /* simulation time */
+  int32_t seqnum;         /* packet fields, or as noted above */
+  int32_t acknum;
+  int32_t checksum;
+  int32_t length;         /* bytes of payload or message */
+  uint8_t kind;           /* TR_ code */
+  uint8_t entity;         /* A or B */
+  char data;              /* first byte of the payload or message */
+  uint8_t unused;
+  int32_t flow;           /* flow of the entity */
+};
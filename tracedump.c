@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+/* ******************************************************************
+   Binary trace decoder.
+
+   Prints a trace file written by the emulator (emulator -tracefile file)
+   as the lines the emulator prints itself at the given TRACE level:
+
+     tracedump [-t level] file
+     tracedump -cwnd file
+
+   or, with -cwnd, the congestion windows of the senders over time as
+   CSV rows of time, flow, entity, cwnd and ssthresh, for plotting.
+
+   The level defaults to 3.  Only the emulator's own lines are recorded,
+   not the event list internals (INSERTEVENT, MOVEEVENT) or anything the
+   protocol prints, and payloads are shown as copies of their first byte,
+   which is what the emulator's messages are made of.
+
+   build: make tracedump
+**********************************************************************/
+
+static void printdata(char data, int length)
+{
+  int i;
+
+  for (i=0; i<length; i++)
+    printf("%c", data);
+  printf("\n");
+}
+
+static void printrecord(const struct tracerec *r, int trace)
+{
+  switch (r->kind) {
+  case TR_EVENT:
+    if (trace < 2)
+      break;
+    printf("\nEVENT time: %f,", r->time);
+    printf("  type: %d", r->checksum);
+    if (r->checksum == 0)
+      printf(", timerinterrupt  ");
+    else if (r->checksum == 1)
+      printf(", fromlayer5 ");
+    else if (r->checksum == 2)
+      printf(", fromlayer3 ");
+    else if (r->checksum == 3)
+      printf(", timerinterrupt %d ", r->seqnum);
+    else
+      printf(", wheeltick ");
+    printf(" entity: %d", r->entity);
+    if (r->flow > 0)
+      printf(" flow: %d", r->flow);
+    printf("\n");
+    break;
+  case TR_ARRIVAL:
+    if (trace > 2)
+      printf("          GENERATE NEXT ARRIVAL: creating new arrival\n");
+    break;
+  case TR_MESSAGE:
+    if (trace > 2) {
+      printf("          MAINLOOP: data given to student: ");
+      printdata(r->data, r->length);
+    }
+    break;
+  case TR_NOMORE:
+    if (trace > 2)
+      printf("          FROM_LAYER5: no more messages to send: \n");
+    break;
+  case TR_TOLAYER3:
+    if (trace > 2) {
+      printf("          TOLAYER3: seq: %d, ack %d, check: %d ", r->seqnum,
+             r->acknum, r->checksum);
+      printdata(r->data, r->length);
+    }
+    break;
+  case TR_LOST:
+    if (trace > 0)
+      printf("          TOLAYER3: packet being lost\n");
+    break;
+  case TR_DROP:
+    if (trace > 0)
+      printf("          TOLAYER3: packet dropped by the router queue\n");
+    break;
+  case TR_REORDER:
+    if (trace > 0)
+      printf("          TOLAYER3: packet being held back\n");
+    break;
+  case TR_DUPLICATE:
+    if (trace > 0)
+      printf("          TOLAYER3: packet being duplicated\n");
+    break;
+  case TR_CORRUPT:
+    if (trace > 0)
+      printf("          TOLAYER3: packet being corrupted\n");
+    break;
+  case TR_SCHEDULE:
+    if (trace > 2)
+      printf("          TOLAYER3: scheduling arrival on other side\n");
+    break;
+  case TR_TOLAYER5:
+    if (trace > 2) {
+      printf("          TOLAYER5: data received by application at %s: ",
+             r->entity == 0 ? "A" : "B");
+      printdata(r->data, r->length);
+    }
+    break;
+  case TR_STARTTIMER:
+    if (trace < 2)
+      break;
+    if (r->seqnum < 0)
+      printf("          START TIMER: starting timer at %f\n", r->time);
+    else
+      printf("          START TIMER %d: starting timer at %f\n", r->seqnum, r->time);
+    break;
+  case TR_STOPTIMER:
+    if (trace < 2)
+      break;
+    if (r->seqnum < 0)
+      printf("          STOP TIMER: stopping timer at %f\n", r->time);
+    else
+      printf("          STOP TIMER %d: stopping timer at %f\n", r->seqnum, r->time);
+    break;
+  case TR_RESTARTTIMER:
+    if (trace > 1)
+      printf("          RESTART TIMER: restarting timer at %f\n", r->time);
+    break;
+  case TR_CWND:
+    if (trace > 2)
+      printf("          CWND: window at %c is %f, ssthresh %f\n", 'A'+r->entity,
+             r->seqnum / 1000.0, r->acknum < 0 ? -1.0 : r->acknum / 1000.0);
+    break;
+  default:
+    fprintf(stderr, "tracedump: unknown record kind %d\n", r->kind);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* the congestion window in r as a CSV row, if it is one */
+static void printcwnd(const struct tracerec *r)
+{
+  if (r->kind == TR_CWND)
+    printf("%f,%d,%c,%f,%f\n", r->time, r->flow, 'A'+r->entity, r->seqnum / 1000.0,
+           r->acknum < 0 ? -1.0 : r->acknum / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+  struct tracerec rec[1024];
+  char magic[8];
+  const char *name = NULL;
+  int trace = 3;
+  int cwnd = 0;
+  size_t n, i;
+  FILE *f;
+  int a;
+
+  for (a=1; a<argc; a++) {
+    if (strcmp(argv[a], "-t") == 0 && a+1 < argc)
+      trace = atoi(argv[++a]);
+    else if (strcmp(argv[a], "-cwnd") == 0)
+      cwnd = 1;
+    else
+      name = argv[a];
+  }
+  if (name == NULL) {
+    fprintf(stderr, "usage: tracedump [-t level | -cwnd] file\n");
+    return EXIT_FAILURE;
+  }
+
+  f = fopen(name, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "tracedump: cannot open %s\n", name);
+    return EXIT_FAILURE;
+  }
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, TRACEMAGIC, 8) != 0) {
+    fprintf(stderr, "tracedump: %s is not a trace file\n", name);
+    fclose(f);
+    return EXIT_FAILURE;
+  }
+  if (cwnd)
+    printf("time,flow,entity,cwnd,ssthresh\n");
+  while ((n = fread(rec, sizeof(struct tracerec), 1024, f)) > 0)
+    for (i=0; i<n; i++) {
+      if (cwnd)
+        printcwnd(&rec[i]);
+      else
+        printrecord(&rec[i], trace);
+    }
+  fclose(f);
+  return EXIT_SUCCESS;
+}